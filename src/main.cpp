@@ -1,9 +1,388 @@
+#include "maze_bitsolver.h"
+#include "maze_format.h"
+#include "maze_kernels.h"
+#include "maze_memory.h"
+#include "maze_pipeline.h"
+#include "maze_stats.h"
+#include "maze_tiles.h"
 #include "maze_utils.h"
 
+#include <algorithm>
+#include <chrono>
 #include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
 
-int main() {
-  mazeUtils::MazeNetwork maze("./maze.bmp");
-  std::cout << maze.toString() << std::endl;
-  return 0;
-}
\ No newline at end of file
+namespace {
+  typedef std::chrono::high_resolution_clock Clock;
+
+  // Below this, per-tile bookkeeping outweighs the records in a tile
+  const std::size_t MIN_TILE_SIZE = 8;
+
+  double secondsSince(Clock::time_point t1) {
+    auto t2 = Clock::now();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count() / 1000000000.0;
+  }
+
+  // Opens the image, checking that it's made of whole cells of the shape
+  std::unique_ptr<mazeUtils::IRowSource> openShapedRows(std::string filePath, const mazeUtils::SolverKernels& kernels) {
+    std::unique_ptr<mazeUtils::IRowSource> rows = mazeUtils::openRowSource(filePath);
+    if (rows && !kernels.fits(rows->width(), rows->height())) {
+      std::cout << "Error - A " << rows->width() << " x " << rows->height() << " image isn't made of whole "
+                << kernels.shape << " cells: " << filePath << std::endl;
+      rows.reset();
+    }
+    return rows;
+  }
+
+  // Builds the node graph from the image, then solves it.
+  int runGraph(std::string filePath, const mazeUtils::SolverKernels& kernels, bool dump, bool stats) {
+    mazeUtils::memoryTracker().resetStats();
+    auto t1 = Clock::now();
+    mazeUtils::MazeNetwork maze;
+    std::unique_ptr<mazeUtils::IRowSource> rows = openShapedRows(filePath, kernels);
+    if (!rows) return 1;
+    if (kernels.parseGraph(maze, *rows) != 0) {
+      std::string error = rows->getError();
+      std::cout << "Error - " << (error.empty() ? "No entrance or exit found" : error) << " in: " << filePath << std::endl;
+      return 1;
+    }
+    double parseTime = secondsSince(t1);
+
+    auto t2 = Clock::now();
+    auto route = maze.solve();
+    double solveTime = secondsSince(t2);
+
+    if (dump) {
+      std::cout << maze.toString() << std::endl;
+    }
+    std::cout << "[graph] Parsed image: " << parseTime << " seconds" << std::endl;
+    std::cout << "[graph] Solved maze: " << solveTime << " seconds" << std::endl;
+    std::cout << "  Nodes: " << maze.getNodeCount() << std::endl;
+    std::cout << "  Memory: " << mazeUtils::memoryTracker().summary() << std::endl;
+    if (stats) {
+      std::cout << mazeUtils::analyzeNetwork(maze, route).toJson(filePath) << std::endl;
+    }
+    if (route.empty()) {
+      std::cout << "  No solution found" << std::endl;
+      return 1;
+    }
+    std::cout << "  Solution length: " << maze.getSolutionLength() << std::endl;
+    return 0;
+  }
+
+  // Floods the packed bitmap directly, without building any nodes.
+  int runBitGrid(std::string filePath, const mazeUtils::SolverKernels& kernels) {
+    mazeUtils::memoryTracker().resetStats();
+    auto t1 = Clock::now();
+    mazeUtils::BitGridSolver maze;
+    std::unique_ptr<mazeUtils::IRowSource> rows = openShapedRows(filePath, kernels);
+    if (!rows || kernels.loadGrid(maze, *rows) != 0) return 1;
+    double loadTime = secondsSince(t1);
+
+    auto t2 = Clock::now();
+    bool solved = kernels.solveGrid(maze);
+    double solveTime = secondsSince(t2);
+
+    std::cout << "[bitgrid] Loaded image: " << loadTime << " seconds" << std::endl;
+    std::cout << "[bitgrid] Solved maze: " << solveTime << " seconds" << std::endl;
+    std::cout << "  Wavefronts: " << maze.getLayerCount() << std::endl;
+    std::cout << "  Memory: " << mazeUtils::memoryTracker().summary() << std::endl;
+    if (!solved) {
+      std::cout << "  No solution found" << std::endl;
+      return 1;
+    }
+    std::cout << "  Solution length: " << maze.getPath().size() - 1 << std::endl;
+    return 0;
+  }
+
+  // Metrics for a maze too big for the node graph. The node and corridor
+  // counts come from a second scan of the rows, the solution metrics from
+  // the tiled route.
+  mazeUtils::MazeStats streamStats(std::string filePath, mazeUtils::TiledNetwork& maze,
+                                   const std::vector<mazeUtils::TiledNetwork::Point>& route) {
+    mazeUtils::MazeStats stats;
+    std::unique_ptr<mazeUtils::IRowSource> rows = mazeUtils::openRowSource(filePath);
+    if (!rows || mazeUtils::analyzeRows(*rows, stats) != 0) {
+      std::string error = rows ? rows->getError() : "";
+      throw std::runtime_error("Couldn't rescan " + filePath + " for statistics" + (error.empty() ? "" : ": " + error));
+    }
+    std::vector<mazeUtils::MazeStats::RouteNode> steps;
+    for (auto it = route.begin(); it != route.end(); it++) {
+      steps.push_back({it->x, it->y, maze.getLinkCount(it->x, it->y)});
+    }
+    stats.addSolution(steps);
+    return stats;
+  }
+
+  // Keeps the node graph in tiles on disk, with only a few tiles in memory.
+  int runTiled(std::string filePath, std::string tileDir, std::size_t tileSize, std::size_t cacheTiles, bool stats) {
+    mazeUtils::memoryTracker().resetStats();
+    mazeUtils::TiledNetwork maze(tileDir, tileSize, cacheTiles);
+    try {
+      auto t1 = Clock::now();
+      if (maze.parseImage(filePath) != 0) return 1;
+      double parseTime = secondsSince(t1);
+      auto parseStats = maze.getStats();
+
+      auto t2 = Clock::now();
+      auto route = maze.solve();
+      double solveTime = secondsSince(t2);
+      auto cacheStats = maze.getStats();
+
+      std::cout << "[tiled] Parsed image: " << parseTime << " seconds" << std::endl;
+      std::cout << "[tiled] Solved maze: " << solveTime << " seconds" << std::endl;
+      std::cout << "  Nodes: " << maze.getNodeCount() << std::endl;
+      std::cout << "  Tiles: " << maze.getTileCount() << " of " << tileSize << "x" << tileSize
+                << " pixels, " << cacheTiles << " cached" << std::endl;
+      std::cout << "  Tile hit rate: " << cacheStats.hitRate() * 100 << "% ("
+                << cacheStats.hits << " hits, " << cacheStats.misses << " misses, "
+                << cacheStats.evictions << " evictions)" << std::endl;
+      std::cout << "  Tile I/O: " << cacheStats.bytesRead << " bytes read, "
+                << cacheStats.bytesWritten << " bytes written ("
+                << cacheStats.bytesRead - parseStats.bytesRead << " read while solving)" << std::endl;
+      std::cout << "  Memory: " << mazeUtils::memoryTracker().summary() << std::endl;
+      if (stats) {
+        std::cout << streamStats(filePath, maze, route).toJson(filePath) << std::endl;
+      }
+      if (route.empty()) {
+        std::cout << "  No solution found" << std::endl;
+        return 1;
+      }
+      std::cout << "  Solution length: " << maze.getSolutionLength() << std::endl;
+    } catch (std::exception const& e) {
+      std::cerr << "Error - " << e.what() << std::endl;
+      return 1;
+    }
+    return 0;
+  }
+
+  // Picks the engine to solve filePath with under the memory budget, going by
+  // the size in the file's header. Mazes too big for the chosen engine are
+  // streamed through the tiled engine instead, with its tiles and cache cut
+  // down to fit, unless streaming isn't allowed. Returns an empty string to refuse.
+  std::string fitToBudget(std::string filePath, std::string engine, bool allowStreaming,
+                          std::size_t& tileSize, std::size_t& cacheTiles) {
+    const std::size_t budget = mazeUtils::memoryTracker().getBudget();
+    std::size_t width, height, decodeBytes;
+    // Files we can't read are left for the engine to report
+    if (budget == 0 || !mazeUtils::readMazeSize(filePath, width, height, decodeBytes)) return engine;
+
+    if (engine != "tiled") {
+      // Whichever engine runs, the decoder's buffer is held alongside it
+      std::size_t estimate = 0;
+      if (engine == "graph" || engine == "compare") {
+        estimate = std::max(estimate, mazeUtils::MazeNetwork::estimateBytes(width, height));
+      }
+      if (engine == "bitgrid" || engine == "compare") {
+        estimate = std::max(estimate, mazeUtils::BitGridSolver::estimateBytes(width, height));
+      }
+      estimate += decodeBytes;
+      if (estimate <= budget) return engine;
+      std::cout << "[" << engine << "] A " << width << " x " << height << " maze needs about "
+                << mazeUtils::formatMegabytes(estimate) << ", over the "
+                << mazeUtils::formatMegabytes(budget) << " memory budget" << std::endl;
+      if (!allowStreaming) return "";
+    }
+
+    // Parsing needs two bands of tiles across the maze cached, however
+    // small the cache, so wide mazes get smaller tiles until those fit
+    auto tiledBytes = [&](std::size_t tiles) {
+      return mazeUtils::TiledNetwork::estimateBytes(width, height, tileSize, tiles) + decodeBytes;
+    };
+    const std::size_t requestedTileSize = tileSize;
+    while (tiledBytes(0) > budget && tileSize / 2 >= MIN_TILE_SIZE) tileSize /= 2;
+    if (tiledBytes(0) > budget) {
+      std::cout << "[tiled] Not even two rows of " << tileSize << "x" << tileSize
+                << " tiles fit in the memory budget" << std::endl;
+      return "";
+    }
+    if (tileSize != requestedTileSize) {
+      std::cout << "[tiled] Cutting tiles to " << tileSize << "x" << tileSize
+                << " pixels so two rows of them fit the memory budget" << std::endl;
+    }
+    if (tiledBytes(cacheTiles) > budget) {
+      // Past the two bands, each cached tile costs the same
+      const std::size_t minimum = mazeUtils::TiledNetwork::parseCacheTiles(width, tileSize);
+      const std::size_t perTile = tiledBytes(minimum + 1) - tiledBytes(minimum);
+      cacheTiles = minimum + (budget - tiledBytes(minimum)) / perTile;
+      std::cout << "[tiled] Cutting the tile cache to " << cacheTiles << " tiles to fit the memory budget" << std::endl;
+    }
+    if (engine != "tiled") {
+      std::cout << "[tiled] Streaming the maze through the tiled engine instead" << std::endl;
+    }
+    return "tiled";
+  }
+
+  // Reads, parses and solves every file at once, one stage per thread
+  int runPipeline(const std::vector<std::string>& filePaths, mazeUtils::MazePipeline::Options options) {
+    mazeUtils::MazePipeline pipeline(options);
+    auto results = pipeline.run(filePaths);
+
+    int failures = 0;
+    for (auto it = results.begin(); it != results.end(); it++) {
+      if (it->solved) {
+        std::cout << it->filePath << ": solution length " << it->solutionLength;
+        if (it->nodes > 0) std::cout << ", " << it->nodes << " nodes";
+        std::cout << std::endl;
+      } else {
+        std::cout << it->filePath << ": " << it->error << std::endl;
+        failures++;
+      }
+    }
+
+    std::cout << "[pipeline] " << results.size() << " mazes in " << pipeline.getWallSeconds()
+              << " seconds (" << options.engine << " engine, " << pipeline.getReaderName() << " reader)" << std::endl;
+    std::cout << "  Memory: " << mazeUtils::memoryTracker().summary() << std::endl;
+    auto stages = pipeline.getStageReports();
+    auto bottleneck = stages.begin();
+    for (auto it = stages.begin(); it != stages.end(); it++) {
+      std::cout << "  " << it->name << ": " << it->utilization * 100 << "% busy ("
+                << it->busySeconds << " seconds across " << it->workers
+                << (it->workers == 1 ? " worker)" : " workers)") << std::endl;
+      if (it->utilization > bottleneck->utilization) bottleneck = it;
+    }
+    std::cout << "  Bottleneck: " << bottleneck->name << std::endl;
+    return failures == 0 ? 0 : 1;
+  }
+}
+
+int main(int argc, char* argv[]) {
+  // Parse arguments
+  std::vector<std::string> filePaths;
+  std::string engine = "graph";
+  bool pipelined = false;
+  std::string shape = mazeUtils::ClassicShape::name();
+  mazeUtils::MazePipeline::Options pipelineOptions;
+  bool dump = false;
+  bool stats = false;
+  std::string tileDir = ".";
+  std::size_t tileSize = 256;
+  std::size_t cacheTiles = 64;
+  std::size_t memoryBudget = 0;
+  bool allowStreaming = true;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg(argv[i]);
+    try {
+      if ((arg == "-e" || arg == "--engine") && i + 1 < argc) {
+        engine = argv[++i];
+      }
+      else if (arg == "-d" || arg == "--dump") {
+        dump = true;
+      }
+      else if (arg == "--stats") {
+        stats = true;
+      }
+      else if (arg == "--tile-dir" && i + 1 < argc) {
+        tileDir = argv[++i];
+      }
+      else if (arg == "--tile-size" && i + 1 < argc) {
+        tileSize = std::stoul(std::string(argv[++i]));
+      }
+      else if (arg == "--tile-cache" && i + 1 < argc) {
+        cacheTiles = std::stoul(std::string(argv[++i]));
+      }
+      else if (arg == "--shape" && i + 1 < argc) {
+        shape = argv[++i];
+      }
+      else if (arg == "-p" || arg == "--pipeline") {
+        pipelined = true;
+      }
+      else if (arg == "--parse-workers" && i + 1 < argc) {
+        pipelineOptions.parseWorkers = std::stoul(std::string(argv[++i]));
+      }
+      else if (arg == "--block-size" && i + 1 < argc) {
+        pipelineOptions.blockSize = std::stoul(std::string(argv[++i])) * 1024;
+      }
+      else if (arg == "--no-uring") {
+        pipelineOptions.useIoUring = false;
+      }
+      else if (arg == "--memory-budget" && i + 1 < argc) {
+        memoryBudget = std::stoul(std::string(argv[++i])) * 1024 * 1024;
+      }
+      else if (arg == "--no-streaming") {
+        allowStreaming = false;
+      }
+      else {
+        filePaths.push_back(arg);
+      }
+    } catch (std::invalid_argument const& e) {
+      std::cerr << "Invalid number: " << argv[i] << std::endl;
+    } catch (std::out_of_range const& e) {
+      std::cerr << "Number out of range: " << argv[i] << std::endl;
+    }
+  }
+
+  if (filePaths.empty()) {
+    filePaths.push_back("./maze.bmp");
+  }
+
+  const mazeUtils::SolverKernels* kernels = mazeUtils::findSolverKernels(shape);
+  if (kernels == NULL) {
+    std::cerr << "Unknown shape: " << shape << " (expected one of";
+    for (auto& entry : mazeUtils::solverKernelTable()) std::cerr << " " << entry.shape;
+    std::cerr << ")" << std::endl;
+    return 1;
+  }
+  if (shape != mazeUtils::ClassicShape::name() && (pipelined || engine == "tiled")) {
+    std::cerr << "Only the " << mazeUtils::ClassicShape::name() << " shape is supported by the "
+              << (pipelined ? "pipeline" : "tiled engine") << std::endl;
+    return 1;
+  }
+
+  if (stats && (pipelined || engine == "bitgrid")) {
+    std::cerr << "Statistics need the graph or tiled engine" << std::endl;
+    return 1;
+  }
+
+  mazeUtils::memoryTracker().setBudget(memoryBudget);
+  // Mazes in other shapes can't be streamed through the tiled engine
+  allowStreaming = allowStreaming && shape == mazeUtils::ClassicShape::name();
+
+  if (pipelined) {
+    if (engine != "graph" && engine != "bitgrid") {
+      std::cerr << "The pipeline only supports the graph and bitgrid engines" << std::endl;
+      return 1;
+    }
+    pipelineOptions.engine = engine;
+    return runPipeline(filePaths, pipelineOptions);
+  }
+
+  int result = 0;
+  for (auto it = filePaths.begin(); it != filePaths.end(); it++) {
+    const std::string& filePath = *it;
+    try {
+      std::size_t fileTileSize = tileSize;
+      std::size_t fileCacheTiles = cacheTiles;
+      std::string fileEngine = fitToBudget(filePath, engine, allowStreaming, fileTileSize, fileCacheTiles);
+      if (fileEngine.empty()) {
+        std::cout << "Error - Refusing to solve " << filePath << " within the memory budget" << std::endl;
+        result = 1;
+      }
+      else if (fileEngine == "graph") {
+        result |= runGraph(filePath, *kernels, dump, stats);
+      }
+      else if (fileEngine == "bitgrid") {
+        result |= runBitGrid(filePath, *kernels);
+      }
+      else if (fileEngine == "tiled") {
+        result |= runTiled(filePath, tileDir, fileTileSize, fileCacheTiles, stats);
+      }
+      else if (fileEngine == "compare") {
+        // Run both pipelines on the same image so their timings can be compared
+        result |= runGraph(filePath, *kernels, dump, stats);
+        result |= runBitGrid(filePath, *kernels);
+      }
+      else {
+        std::cerr << "Unknown engine: " << engine << " (expected graph, bitgrid, tiled or compare)" << std::endl;
+        return 1;
+      }
+    } catch (std::exception const& e) {
+      std::cerr << "Error - " << filePath << ": " << e.what() << std::endl;
+      result = 1;
+    }
+  }
+  return result;
+}
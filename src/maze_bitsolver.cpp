@@ -0,0 +1,200 @@
+#include "maze_bitsolver.h"
+
+#include <algorithm>
+#include <iostream>
+
+#ifdef DEBUG
+#define LOG(x) std::cout << x << std::endl;
+#else
+#define LOG(x)
+#endif
+
+namespace mazeUtils {
+  BitGridSolver::BitGridSolver() {}
+
+  BitGridSolver::BitGridSolver(std::string filePath) {
+    this->loadImage(filePath);
+  }
+
+  int BitGridSolver::loadImage(std::string filePath) {
+    std::unique_ptr<IRowSource> rows = openRowSource(filePath);
+    if (!rows) return 1;
+    return load(*rows);
+  }
+
+  int BitGridSolver::load(IRowSource& rows) {
+    width = rows.width();
+    height = rows.height();
+    wordsPerRow = wordsForWidth(width);
+    open.assign(height * wordsPerRow, 0);
+    layers.clear();
+    path.clear();
+
+    PackedRow row;
+    for (std::size_t y = 0; y < height; ++y) {
+      if (!rows.nextRow(row)) {
+        std::string error = rows.getError();
+        if (error.empty()) error = "Maze image ended after " + std::to_string(y) + " rows";
+        std::cout << "Error - " << error << std::endl;
+        return 1;
+      }
+      std::copy(row.begin(), row.end(), open.begin() + y * wordsPerRow);
+    }
+    return 0;
+  }
+
+  bool BitGridSolver::solve() {
+    return solveWith<fourConnected>();
+  }
+
+  template <Connectivity C>
+  bool BitGridSolver::solveWith() {
+    layers.clear();
+    path.clear();
+    if (height == 0) return false;
+
+    TrackedVector<uint64_t> visited(open.size(), 0);
+
+    // Every open pixel in the top row is an entrance
+    Layer entrance;
+    for (std::size_t w = 0; w < wordsPerRow; ++w) {
+      if (open[w]) {
+        entrance.push_back({w, open[w]});
+        visited[w] = open[w];
+      }
+    }
+    if (entrance.empty()) return false;
+    layers.push_back(entrance);
+
+    const std::size_t exitRow = (height - 1) * wordsPerRow;
+    while (true) {
+      // Layers are sorted by index, so the exit row is always at the back
+      const Layer& frontier = layers.back();
+      if (frontier.back().index >= exitRow) break;
+
+      Layer next;
+      expand<C>(frontier, visited, next);
+      if (next.empty()) {
+        LOG("Flood fill ran out of pixels after " << layers.size() << " layers");
+        return false;
+      }
+      layers.push_back(std::move(next));
+    }
+
+    tracePath<C>();
+    return true;
+  }
+
+
+  template <Connectivity C>
+  void BitGridSolver::expand(const Layer& frontier, TrackedVector<uint64_t>& visited, Layer& next) {
+    // Spread every frontier word one pixel in each direction. Bits that
+    // cross a word boundary carry into the neighbouring word of the row.
+    // Eight-connected moves spread the rows above and below sideways too.
+    Layer candidates;
+    candidates.reserve(frontier.size() * (C == eightConnected ? 9 : 5));
+    for (auto it = frontier.begin(); it != frontier.end(); it++) {
+      const std::size_t y = it->index / wordsPerRow;
+      const std::size_t w = it->index % wordsPerRow;
+      const uint64_t bits = it->bits;
+      const uint64_t sideways = (bits << 1) | (bits >> 1);
+      const uint64_t vertical = (C == eightConnected) ? (bits | sideways) : bits;
+
+      candidates.push_back({it->index, sideways});
+      if (w > 0) candidates.push_back({it->index - 1, bits << 63});
+      if (w + 1 < wordsPerRow) candidates.push_back({it->index + 1, bits >> 63});
+      if (y > 0) {
+        candidates.push_back({it->index - wordsPerRow, vertical});
+        if (C == eightConnected && w > 0) candidates.push_back({it->index - wordsPerRow - 1, bits << 63});
+        if (C == eightConnected && w + 1 < wordsPerRow) candidates.push_back({it->index - wordsPerRow + 1, bits >> 63});
+      }
+      if (y + 1 < height) {
+        candidates.push_back({it->index + wordsPerRow, vertical});
+        if (C == eightConnected && w > 0) candidates.push_back({it->index + wordsPerRow - 1, bits << 63});
+        if (C == eightConnected && w + 1 < wordsPerRow) candidates.push_back({it->index + wordsPerRow + 1, bits >> 63});
+      }
+    }
+    std::sort(candidates.begin(), candidates.end(),
+      [](const Word& a, const Word& b) { return a.index < b.index; });
+
+    // Merge words with the same index, then keep only open, unvisited pixels
+    for (std::size_t i = 0; i < candidates.size();) {
+      const std::size_t index = candidates[i].index;
+      uint64_t bits = 0;
+      for (; i < candidates.size() && candidates[i].index == index; ++i) {
+        bits |= candidates[i].bits;
+      }
+      bits &= open[index] & ~visited[index];
+      if (bits) {
+        visited[index] |= bits;
+        next.push_back({index, bits});
+      }
+    }
+  }
+
+  bool BitGridSolver::layerContains(const Layer& layer, std::size_t index, uint64_t bit) {
+    auto it = std::lower_bound(layer.begin(), layer.end(), index,
+      [](const Word& word, std::size_t value) { return word.index < value; });
+    return it != layer.end() && it->index == index && (it->bits & bit);
+  }
+
+  template <Connectivity C>
+  void BitGridSolver::tracePath() {
+    // Start from the lowest exit pixel reached by the final wavefront
+    const Word& exitWord = layers.back().back();
+    std::size_t bit = 0;
+    while (!((exitWord.bits >> bit) & 1)) bit++;
+    std::size_t x = (exitWord.index % wordsPerRow) * BITS_PER_WORD + bit;
+    std::size_t y = height - 1;
+    path.push_back({x, y});
+
+    // Each earlier wavefront must hold a neighbour of the current pixel.
+    // Straight moves are listed first, so they're preferred over diagonals.
+    for (std::size_t layer = layers.size() - 1; layer-- > 0;) {
+      const Point candidates[8] = {
+        {x, y - 1}, {x, y + 1}, {x + 1, y}, {x - 1, y},
+        {x + 1, y - 1}, {x + 1, y + 1}, {x - 1, y + 1}, {x - 1, y - 1}
+      };
+      for (int i = 0; i < (int)C; ++i) {
+        const Point& p = candidates[i];
+        if (p.x >= width || p.y >= height) continue;
+        const std::size_t index = p.y * wordsPerRow + p.x / BITS_PER_WORD;
+        if (layerContains(layers[layer], index, uint64_t(1) << (p.x % BITS_PER_WORD))) {
+          x = p.x;
+          y = p.y;
+          break;
+        }
+      }
+      path.push_back({x, y});
+    }
+    std::reverse(path.begin(), path.end());
+  }
+
+  std::size_t BitGridSolver::getWidth() {
+    return this->width;
+  }
+
+  std::size_t BitGridSolver::getHeight() {
+    return this->height;
+  }
+
+  const TrackedVector<BitGridSolver::Point>& BitGridSolver::getPath() {
+    return this->path;
+  }
+
+  std::size_t BitGridSolver::getLayerCount() {
+    return this->layers.size();
+  }
+
+  std::size_t BitGridSolver::estimateBytes(std::size_t width, std::size_t height) {
+    // The open and visited bitmaps, plus the wavefronts: a maze with one
+    // pixel walls has at most one open pixel in two, and corridors rarely
+    // put more than one pixel of a wavefront in the same word.
+    const std::size_t bitmap = wordsForWidth(width) * height * sizeof(uint64_t);
+    const std::size_t openPixels = width * height / 2;
+    return 2 * bitmap + openPixels * (sizeof(Word) + sizeof(Point));
+  }
+
+  template bool BitGridSolver::solveWith<fourConnected>();
+  template bool BitGridSolver::solveWith<eightConnected>();
+}
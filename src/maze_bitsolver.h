@@ -0,0 +1,90 @@
+#pragma once
+
+#include "maze_kernels.h"
+#include "maze_memory.h"
+#include "maze_rows.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace mazeUtils {
+  // Solves a maze directly on its packed pixel bitmap, without building a
+  // MazeNetwork. A breadth-first flood fill advances 64 pixels at a time
+  // using shifts and masks on whole words, and every wavefront is kept so
+  // the shortest path can be traced back from the exit once it is reached.
+  class BitGridSolver {
+    public:
+      struct Point {
+        std::size_t x, y;
+      };
+
+      BitGridSolver();
+      BitGridSolver(std::string filePath);
+
+      int loadImage(std::string filePath);
+      int load(IRowSource& rows);
+      // Floods from the entrance row until the exit row is reached. Returns
+      // false if the exit can't be reached.
+      bool solve();
+      // As solve(), moving between pixels with connectivity C. Instantiated
+      // for every Connectivity.
+      template <Connectivity C>
+      bool solveWith();
+
+      std::size_t getWidth();
+      std::size_t getHeight();
+      // Pixels on the shortest path, from the entrance to the exit.
+      const TrackedVector<Point>& getPath();
+      // After solving the lattice of a four-connected Shape maze (see
+      // LatticeRowSource), swaps the path for the pixels it runs through, so
+      // its length is in pixels too.
+      template <class Shape>
+      void mapPathToPixels();
+      // Number of wavefronts expanded, including the entrance row.
+      std::size_t getLayerCount();
+      // Rough upper bound on what load() and solve() allocate for a maze
+      // of width x height pixels
+      static std::size_t estimateBytes(std::size_t width, std::size_t height);
+    private:
+      // One non-empty word of a wavefront. index is y * wordsPerRow + word.
+      struct Word {
+        std::size_t index;
+        uint64_t bits;
+      };
+      typedef TrackedVector<Word> Layer;
+
+      std::size_t width = 0;
+      std::size_t height = 0;
+      std::size_t wordsPerRow = 0;
+      TrackedVector<uint64_t> open;
+      TrackedVector<Layer> layers;
+      TrackedVector<Point> path;
+
+      template <Connectivity C>
+      void expand(const Layer& frontier, TrackedVector<uint64_t>& visited, Layer& next);
+      static bool layerContains(const Layer& layer, std::size_t index, uint64_t bit);
+      template <Connectivity C>
+      void tracePath();
+  };
+
+  template <class Shape>
+  void BitGridSolver::mapPathToPixels() {
+    TrackedVector<Point> pixels;
+    for (std::size_t i = 0; i < path.size(); i++) {
+      const Point to = { Shape::latticeToPixel(path[i].x, width), Shape::latticeToPixel(path[i].y, height) };
+      // Lattice steps are straight, so so are the runs of pixels between them
+      Point at = i == 0 ? to : pixels.back();
+      while (at.x != to.x || at.y != to.y) {
+        if (at.x < to.x) at.x++;
+        else if (at.x > to.x) at.x--;
+        else if (at.y < to.y) at.y++;
+        else at.y--;
+        pixels.push_back(at);
+      }
+      if (i == 0) pixels.push_back(to);
+    }
+    path.swap(pixels);
+  }
+}
@@ -4,6 +4,7 @@
 #include <thread>
 
 #include "maze_builder.h"
+#include "maze_format.h"
 
 #include "bitmap_image.hpp"
 
@@ -17,68 +18,146 @@ namespace mazeBuilder {
     DepthFirstBuilder::DepthFirstBuilder(
         unsigned long seed,
         unsigned int xSize,
-        unsigned int ySize
+        unsigned int ySize,
+        std::string shape
     )
     : xSize(xSize),
-    ySize(ySize)              
+    ySize(ySize),
+    kernels(NULL)
     {
+        for (auto& entry : shapeTable()) {
+            if (entry.name == shape) {
+                kernels = &entry;
+            }
+        }
+        if (kernels == NULL) {
+            throw std::invalid_argument("Unknown maze shape: " + shape);
+        }
         buildMaze(seed);
     }
 
-    void DepthFirstBuilder::makeImage(std::string fileName) {
-        auto t1 = std::chrono::high_resolution_clock::now();
-        typedef std::vector<std::vector<bool>> pixels; // true = white, false = black
-        pixels mazePixels;
-        // Initialize pixel map
-        for (unsigned int x = 0; x < xSize; x++) {
-            std::vector<bool> tmpRow;
-            for (unsigned int y = 0; y < ySize; y++) {
-                tmpRow.push_back(false);
+    const std::vector<DepthFirstBuilder::ShapeKernels>& DepthFirstBuilder::shapeTable() {
+        static const std::vector<ShapeKernels> table = []() {
+            std::vector<ShapeKernels> entries;
+            mazeUtils::forEachShape([&entries](auto shape) {
+                typedef decltype(shape) Shape;
+                ShapeKernels entry = {
+                    Shape::name(),
+                    &DepthFirstBuilder::sizeMaze<Shape>,
+                    &DepthFirstBuilder::carveMaze<Shape::connectivity>,
+                    &DepthFirstBuilder::renderPixels<Shape>,
+                    &DepthFirstBuilder::estimateFor<Shape>
+                };
+                entries.push_back(entry);
+            });
+            return entries;
+        }();
+        return table;
+    }
+
+    std::vector<std::string> DepthFirstBuilder::shapeNames() {
+        std::vector<std::string> names;
+        for (auto& entry : shapeTable()) {
+            names.push_back(entry.name);
+        }
+        return names;
+    }
+
+    std::size_t DepthFirstBuilder::estimateBytes(unsigned int xSize, unsigned int ySize, std::string shape) {
+        for (auto& entry : shapeTable()) {
+            if (entry.name == shape) {
+                return entry.estimateBytes(xSize, ySize);
             }
-            mazePixels.push_back(tmpRow);
         }
+        throw std::invalid_argument("Unknown maze shape: " + shape);
+    }
 
-        // First row - add start of maze
-        mazePixels[xStart][0] = true;
+    template <class Shape>
+    std::size_t DepthFirstBuilder::estimateFor(unsigned int xSize, unsigned int ySize) {
+        const std::size_t xCells = Shape::cellsFor(xSize);
+        const std::size_t yCells = Shape::cellsFor(ySize);
+        // Every cell has a map entry for each orthogonal direction, and
+        // eight-connected cells gain more for their diagonal links
+        const std::size_t mapEntry = sizeof(std::pair<const directions, Cell*>) + 4 * sizeof(void*);
+        const std::size_t perCell = sizeof(Cell) + Shape::connectivity * mapEntry;
+        // The rendered image is a bit per pixel, one vector per column
+        const std::size_t column = sizeof(mazeUtils::TrackedVector<bool>) + (ySize + 63) / 64 * sizeof(uint64_t);
+        return xCells * yCells * perCell + xCells * sizeof(mazeUtils::TrackedVector<Cell>) + xSize * column;
+    }
+
+    DepthFirstBuilder::pixels DepthFirstBuilder::buildPixels() {
+        return (this->*(kernels->renderPixels))();
+    }
+
+    template <class Shape>
+    DepthFirstBuilder::pixels DepthFirstBuilder::renderPixels() {
+        // Initialize pixel map
+        pixels mazePixels(xSize, mazeUtils::TrackedVector<bool>(ySize, false));
+        auto fill = [&mazePixels](unsigned int left, unsigned int top, unsigned int width, unsigned int height) {
+            for (unsigned int x = left; x < left + width; x++) {
+                for (unsigned int y = top; y < top + height; y++) {
+                    mazePixels[x][y] = true;
+                }
+            }
+        };
+        // Cells are linked only if both of them agree
+        auto linked = [this](unsigned int xCell, unsigned int yCell, directions dir, unsigned int xNext, unsigned int yNext) {
+            Cell& from = mazeCells[xCell][yCell];
+            Cell& to = mazeCells[xNext][yNext];
+            auto there = from.connections.find(dir);
+            auto back = to.connections.find(invertDirection(dir));
+            return there != from.connections.end() && there->second == &to
+                && back != to.connections.end() && back->second == &from;
+        };
+        const unsigned int cell = Shape::cellWidth;
+        const unsigned int wall = Shape::wallWidth;
+
+        // First rows - add start of maze through the top border
+        fill(Shape::cellStart(xStart), 0, cell, wall);
 
         // Maze rows
         for (unsigned int xCell = 0; xCell < xCells; xCell++) {
             for (unsigned int yCell = 0; yCell < yCells; yCell++) {
-                // Cells are technically 2x2 pixel squares. Start with the top left
-                // pixel of each square, and derive the others based on that cell's
-                // connections to adjacent cells.
-                unsigned int xPixel = (xCell * 2) + 1;
-                unsigned int yPixel = (yCell * 2) + 1;
-                if (mazeCells[xCell][yCell].visited)
-                {
-                    // If it is not a wall, it is part of the maze path
-                    mazePixels[xPixel][yPixel] = true;
-
-                    // Now check the connections below and to the right of this cell,
-                    // and color the pixels accordingly. Don't do this on the last
-                    // cell row/column.
-                    if (xCell < xCells - 1) {
-                        // Not the last column - check to the right
-                        if (mazeCells[xCell][yCell].connections[east] == &mazeCells[xCell+1][yCell]
-                        && mazeCells[xCell+1][yCell].connections[west] == &mazeCells[xCell][yCell]) {
-                            mazePixels[xPixel+1][yPixel] = true;
+                if (!mazeCells[xCell][yCell].visited) {
+                    continue;
+                }
+                // Each cell is a square block of pixels. Open it up, then open
+                // the wall below and to the right of it if the cells are linked.
+                unsigned int xPixel = Shape::cellStart(xCell);
+                unsigned int yPixel = Shape::cellStart(yCell);
+                fill(xPixel, yPixel, cell, cell);
+                if (xCell < xCells - 1 && linked(xCell, yCell, east, xCell + 1, yCell)) {
+                    fill(xPixel + cell, yPixel, wall, cell);
+                }
+                if (yCell < yCells - 1 && linked(xCell, yCell, south, xCell, yCell + 1)) {
+                    fill(xPixel, yPixel + cell, cell, wall);
+                }
+                if (Shape::connectivity == mazeUtils::eightConnected && yCell < yCells - 1) {
+                    // Diagonal passages are a one pixel staircase through the
+                    // wall corner, touching the two cells only at their corners
+                    if (xCell < xCells - 1 && linked(xCell, yCell, southEast, xCell + 1, yCell + 1)) {
+                        for (unsigned int step = 0; step < wall; step++) {
+                            mazePixels[xPixel + cell + step][yPixel + cell + step] = true;
                         }
                     }
-                    if (yCell < yCells - 1) {
-                        // Not the last row - check below
-                        if (mazeCells[xCell][yCell].connections[south] == &mazeCells[xCell][yCell+1]
-                        && mazeCells[xCell][yCell+1].connections[north] == &mazeCells[xCell][yCell]) {
-                            mazePixels[xPixel][yPixel+1] = true;
+                    if (xCell > 0 && linked(xCell, yCell, southWest, xCell - 1, yCell + 1)) {
+                        for (unsigned int step = 0; step < wall; step++) {
+                            mazePixels[xPixel - 1 - step][yPixel + cell + step] = true;
                         }
                     }
                 }
             }
         }
 
-        // Last row(s) (this will hit the same row twice if there is only one border row)
-        mazePixels[xEnd][2*yCells] = true; // Set the row just below the maze
-        mazePixels[xEnd][ySize-1] = true; // Set last row
+        // Last rows - add end of maze through the bottom border
+        fill(Shape::cellStart(xEnd), ySize - wall, cell, wall);
 
+        return mazePixels;
+    }
+
+    void DepthFirstBuilder::makeImage(std::string fileName) {
+        auto t1 = std::chrono::high_resolution_clock::now();
+        pixels mazePixels = buildPixels();
 
         // Draw our pixel map to an image
         bitmap_image image(xSize, ySize);
@@ -101,6 +180,53 @@ namespace mazeBuilder {
         std::cout << "Created image: " << duration << " seconds" << std::endl;
     }
 
+    void DepthFirstBuilder::makeNative(std::string fileName, bool rle) {
+        auto t1 = std::chrono::high_resolution_clock::now();
+        pixels mazePixels = buildPixels();
+
+        mazeUtils::NativeMazeWriter writer(fileName, xSize, ySize, rle);
+        if (!writer.isOpen()) {
+            throw std::runtime_error("Failed to open " + fileName + " for writing");
+        }
+        mazeUtils::PackedRow row;
+        for (std::size_t y = 0; y < ySize; y++) {
+            packRow(mazePixels, y, row);
+            writer.writeRow(row);
+        }
+        if (!writer.close()) {
+            throw std::runtime_error("Failed to write " + fileName);
+        }
+        auto t2 = std::chrono::high_resolution_clock::now();
+        auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count() / 1000000000.0;
+        std::cout << "Created native maze: " << duration << " seconds" << std::endl;
+    }
+
+    std::vector<mazeUtils::PackedRow> DepthFirstBuilder::makeRows() {
+        pixels mazePixels = buildPixels();
+        std::vector<mazeUtils::PackedRow> rows(ySize);
+        for (std::size_t y = 0; y < ySize; y++) {
+            packRow(mazePixels, y, rows[y]);
+        }
+        return rows;
+    }
+
+    unsigned int DepthFirstBuilder::getWidth() {
+        return xSize;
+    }
+
+    unsigned int DepthFirstBuilder::getHeight() {
+        return ySize;
+    }
+
+    void DepthFirstBuilder::packRow(const pixels& mazePixels, std::size_t y, mazeUtils::PackedRow& row) {
+        row.assign(mazeUtils::wordsForWidth(xSize), 0);
+        for (std::size_t x = 0; x < xSize; x++) {
+            if (mazePixels[x][y]) {
+                mazeUtils::setOpen(row, x);
+            }
+        }
+    }
+
     DepthFirstBuilder::Cell::Cell(unsigned int x, unsigned int y) 
     : x(x),
     y(y),
@@ -123,43 +249,69 @@ namespace mazeBuilder {
         std::srand(seed);
 
         LOG("buildMaze - initializing");
+        (this->*(kernels->sizeMaze))();
+
+        // Set values for start/end column. These are cell columns; the
+        // entrance and exit are opened up through the border when rendering.
+        xStart = std::rand() % xCells;
+        xEnd = std::rand() % xCells;
+
+        // Initialize our grid of cells
+        for (unsigned int x = 0; x < xCells; x++) {
+            mazeUtils::TrackedVector<Cell> tmpColumn;
+            for (unsigned int y = 0; y < yCells; y++) {
+                tmpColumn.push_back(Cell(x,y));
+            }
+            mazeCells.push_back(tmpColumn);
+        }
+
+        (this->*(kernels->carveMaze))();
+
+        auto t2 = std::chrono::high_resolution_clock::now();
+        auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count() / 1000000000.0;
+        std::cout << "Built maze: " << duration << " seconds" << std::endl;
+        std::cout << "  Seed: " << seed << std::endl;
+        std::cout << "  Shape: " << kernels->name << std::endl;
+        std::cout << "  Size: " << xSize << " x " << ySize << std::endl;
+        std::cout << "  Pixels: " << xSize * ySize << std::endl;
+        std::cout << "  Cells: " << xCells * yCells << std::endl;
+    }
 
-        // Create our structure of cells. Since walls are 1 pixel wide, we set up
-        // a cell every 2 pixels. The border of the maze is also 1 pixel wide.
-        const unsigned int CELL_BORDER_TOTAL_WIDTH = 2;
-        if(xSize <= CELL_BORDER_TOTAL_WIDTH || ySize <= CELL_BORDER_TOTAL_WIDTH) {
+    template <class Shape>
+    void DepthFirstBuilder::sizeMaze() {
+        // Create our structure of cells. Cells are Shape::cellWidth pixels
+        // square and separated by walls Shape::wallWidth pixels thick. The
+        // border of the maze is as thick as the walls.
+        xCells = Shape::cellsFor(xSize);
+        yCells = Shape::cellsFor(ySize);
+        if (xCells == 0 || yCells == 0) {
             throw std::invalid_argument("Maze is too small to generate");
         }
 
-        // Round down the size to an odd number, so the maze sits evenly with the
-        // one pixel border on the outside.
-        if (xSize % 2 == 0) {
-            LOG("Rounding down xSize " << xSize << " to odd number " << xSize-1);
-            xSize--;
+        // Round down the size to a whole number of cells, so the maze sits
+        // evenly inside the border.
+        if (Shape::pixelsFor(xCells) != xSize) {
+            LOG("Rounding down xSize " << xSize << " to " << Shape::pixelsFor(xCells));
+            xSize = Shape::pixelsFor(xCells);
         }
-        if (ySize % 2 == 0) {
-            LOG("Rounding down ySize " << ySize << " to odd number " << ySize-1);
-            ySize--;
+        if (Shape::pixelsFor(yCells) != ySize) {
+            LOG("Rounding down ySize " << ySize << " to " << Shape::pixelsFor(yCells));
+            ySize = Shape::pixelsFor(yCells);
         }
 
-        xCells = ((xSize - CELL_BORDER_TOTAL_WIDTH)/2) + 1;
-        yCells = ((ySize - CELL_BORDER_TOTAL_WIDTH)/2) + 1;
+        // printMaze always draws the classic one pixel layout
         xPixels = (2 * xCells) - 1;
         yPixels = (2 * yCells) - 1;
+    }
 
-        // Set values for start/end column. These are not stored as cells, just pixel values.
-        // Values are +1 because the maze starts at x=1.
-        xStart = (std::rand() % xCells) * 2 + 1;
-        xEnd = (std::rand() % xCells) * 2 + 1;
-
-        // Initialize our grid of cells
-        for (unsigned int x = 0; x < xCells; x++) {
-            std::vector<Cell> tmpColumn;
-            for (unsigned int y = 0; y < yCells; y++) {
-                tmpColumn.push_back(Cell(x,y));
-            }
-            mazeCells.push_back(tmpColumn);
-        }
+    template <mazeUtils::Connectivity C>
+    void DepthFirstBuilder::carveMaze() {
+        // Steps to the neighbouring cell, in the order of the directions enum
+        static const int X_STEP[] = { 0, 1, 0, -1, 1, 1, -1, -1 };
+        static const int Y_STEP[] = { -1, 0, 1, 0, -1, 1, 1, -1 };
+#ifdef DEBUG
+        static const char* const NAMES[] = { "north", "east", "south", "west", "north east", "south east", "south west", "north west" };
+#endif
 
         // Now start traversing via depth-first search
         Cell* next = &(mazeCells[0][0]);
@@ -176,17 +328,18 @@ namespace mazeBuilder {
             LOG("next: x " << next->x << " y " << next->y);
             // Decide which directions we can go
             options.clear();
-            if (next->y > 0 && !mazeCells[next->x][next->y - 1].visited) {
-                options.push_back(north);
-            }
-            if (next->x < xCells - 1 && !mazeCells[next->x + 1][next->y].visited) {
-                options.push_back(east);
-            }
-            if (next->y < yCells - 1 && !mazeCells[next->x][next->y + 1].visited) {
-                options.push_back(south);
-            }
-            if (next->x > 0 && !mazeCells[next->x - 1][next->y].visited) {
-                options.push_back(west);
+            for (int dir = 0; dir < C; dir++) {
+                long x = static_cast<long>(next->x) + X_STEP[dir];
+                long y = static_cast<long>(next->y) + Y_STEP[dir];
+                if (x < 0 || x >= xCells || y < 0 || y >= yCells || mazeCells[x][y].visited) {
+                    continue;
+                }
+                // Diagonal passages share the wall corner with the opposite
+                // diagonal, so they can't cross one that is already there
+                if (dir >= northEast && crossesDiagonal(next->x, next->y, x, y)) {
+                    continue;
+                }
+                options.push_back(static_cast<directions>(dir));
             }
             LOG("choices - " << options.size());
 
@@ -209,27 +362,8 @@ namespace mazeBuilder {
             directions choice = options[std::rand() % options.size()];
             // And now go in that direction
             prev = next;
-            switch (choice) {
-                case north:
-                    next = &mazeCells[next->x][next->y - 1];
-                    LOG("going north");
-                    break;
-                case east:
-                    next = &mazeCells[next->x + 1][next->y];
-                    LOG("going east");
-                    break;
-                case south:
-                    next = &mazeCells[next->x][next->y + 1];
-                    LOG("going south");
-                    break;
-                case west:
-                    next = &mazeCells[next->x - 1][next->y];
-                    LOG("going west");
-                    break;
-                default:
-                    throw std::out_of_range("Unexpected value for direction");
-                    break;
-            }
+            next = &mazeCells[next->x + X_STEP[choice]][next->y + Y_STEP[choice]];
+            LOG("going " << NAMES[choice]);
             prev->connections[choice] = next;
             next->connections[invertDirection(choice)] = prev;
             next->prev = prev;
@@ -239,13 +373,17 @@ namespace mazeBuilder {
             std::this_thread::sleep_for (std::chrono::seconds(1));
 #endif
         } while (prev != NULL);
-        auto t2 = std::chrono::high_resolution_clock::now();
-        auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count() / 1000000000.0;
-        std::cout << "Built maze: " << duration << " seconds" << std::endl;
-        std::cout << "  Seed: " << seed << std::endl;
-        std::cout << "  Size: " << xSize << " x " << ySize << std::endl;
-        std::cout << "  Pixels: " << xSize * ySize << std::endl;
-        std::cout << "  Cells: " << xCells * yCells << std::endl;
+    }
+
+    bool DepthFirstBuilder::crossesDiagonal(unsigned int xFrom, unsigned int yFrom, unsigned int xTo, unsigned int yTo) {
+        Cell& corner = mazeCells[xTo][yFrom];
+        Cell* opposite = &mazeCells[xFrom][yTo];
+        for (auto it = corner.connections.begin(); it != corner.connections.end(); it++) {
+            if (it->second == opposite) {
+                return true;
+            }
+        }
+        return false;
     }
 
     void DepthFirstBuilder::printMaze(int currXCell, int currYCell) {
@@ -309,34 +447,3 @@ namespace mazeBuilder {
         }
     }
 }
-
-int main(int argc, char* argv[]) {
-    // Parse arguments
-    unsigned long seed = time(NULL);
-    unsigned int width = 21;
-    unsigned int height = 21;
-
-    for (int i = 1; i < argc; i++) {
-        std::string arg(argv[i]);
-        try {
-            if (arg == "-s" || arg == "--seed") {
-                seed = std::stol(std::string(argv[++i]));
-            }
-            else if (arg == "-w" || arg == "--width") {
-                width = std::stoi(std::string(argv[++i]));
-            }
-            else if (arg == "-h" || arg == "--height") {
-                height = std::stoi(std::string(argv[++i]));
-            }
-        } catch (std::invalid_argument const& e) {
-            std::cerr << "Invalid number: " << argv[i] << std::endl;
-        } catch (std::out_of_range const& e) {
-            std::cerr << "Number out of range: " << argv[i] << std::endl;
-        }
-    }
-
-    mazeBuilder::DepthFirstBuilder maze(seed, width, height);
-    maze.makeImage("maze.bmp");
-    std::cout << "Maze created!" << std::endl;
-    return 0;
-}
\ No newline at end of file
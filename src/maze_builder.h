@@ -1,3 +1,6 @@
+#include "maze_kernels.h"
+#include "maze_memory.h"
+
 #include <map>
 #include <stdexcept>
 #include <string>
@@ -15,6 +18,7 @@ namespace mazeBuilder {
             virtual ~IMazeBuilder() {}
 
             virtual void makeImage(std::string fileName) = 0;
+            virtual void makeNative(std::string fileName, bool rle) = 0;
     };
 
     class DepthFirstBuilder : public IMazeBuilder {
@@ -22,22 +26,45 @@ namespace mazeBuilder {
             DepthFirstBuilder(
                 unsigned long seed,
                 unsigned int xSize,
-                unsigned int ySize
+                unsigned int ySize,
+                std::string shape = mazeUtils::ClassicShape::name()
             );
 
             virtual ~DepthFirstBuilder() {}
 
+            // Names of the shapes mazes can be built in (see maze_kernels.h)
+            static std::vector<std::string> shapeNames();
+            // Rough upper bound on what building and writing a maze allocates
+            static std::size_t estimateBytes(
+                unsigned int xSize,
+                unsigned int ySize,
+                std::string shape = mazeUtils::ClassicShape::name()
+            );
+
             virtual void makeImage(std::string fileName = "maze.bmp");
+            // Writes the maze in the compact native format (see maze_format.h)
+            virtual void makeNative(std::string fileName = "maze.maze", bool rle = true);
+            // Renders the maze to packed rows, top to bottom, without writing a file
+            std::vector<mazeUtils::PackedRow> makeRows();
+            // Size of the maze in pixels, after rounding to whole cells
+            unsigned int getWidth();
+            unsigned int getHeight();
         private:
             unsigned int xSize, ySize; // Width of maze in pixels (including border)
             unsigned int xPixels, yPixels; // Width of maze in pixels (without border)
             unsigned int xCells, yCells; // Width of maze in cells
-            unsigned int xStart, xEnd; // Column number for start/end of maze
+            unsigned int xStart, xEnd; // Cell column for start/end of maze
+            // The four orthogonal directions come first, so a four-connected
+            // maze only looks at the first four
             enum directions {
                 north,
                 east,
                 south,
-                west
+                west,
+                northEast,
+                southEast,
+                southWest,
+                northWest
             };
 
             inline directions invertDirection(directions dir) {
@@ -50,6 +77,14 @@ namespace mazeBuilder {
                         return north;
                     case west:
                         return east;
+                    case northEast:
+                        return southWest;
+                    case southEast:
+                        return northWest;
+                    case southWest:
+                        return northEast;
+                    case northWest:
+                        return southEast;
                     default:
                         throw std::out_of_range("Unexpected value for direction");
                         break;
@@ -65,11 +100,34 @@ namespace mazeBuilder {
                     bool wall;
                     bool visited;
                     Cell* prev;
-                    std::map<directions, Cell*> connections;
+                    std::map<directions, Cell*, std::less<directions>,
+                        mazeUtils::TrackingAllocator<std::pair<const directions, Cell*>>> connections;
             };
 
-            typedef std::vector<std::vector<Cell>> mazeType;
+            typedef mazeUtils::TrackedVector<mazeUtils::TrackedVector<Cell>> mazeType;
             mazeType mazeCells;
+
+            typedef mazeUtils::TrackedVector<mazeUtils::TrackedVector<bool>> pixels; // true = white, false = black
+            pixels buildPixels();
+            void packRow(const pixels& mazePixels, std::size_t y, mazeUtils::PackedRow& row);
+
+            // One row of the builder's dispatch table: the kernels specialised for a shape
+            struct ShapeKernels {
+                std::string name;
+                void (DepthFirstBuilder::*sizeMaze)();
+                void (DepthFirstBuilder::*carveMaze)();
+                pixels (DepthFirstBuilder::*renderPixels)();
+                std::size_t (*estimateBytes)(unsigned int xSize, unsigned int ySize);
+            };
+            static const std::vector<ShapeKernels>& shapeTable();
+            const ShapeKernels* kernels;
+
+            template <class Shape> void sizeMaze();
+            template <mazeUtils::Connectivity C> void carveMaze();
+            template <class Shape> pixels renderPixels();
+            template <class Shape> static std::size_t estimateFor(unsigned int xSize, unsigned int ySize);
+            // True if the diagonal between the two cells would cross another one
+            bool crossesDiagonal(unsigned int xFrom, unsigned int yFrom, unsigned int xTo, unsigned int yTo);
             
             void buildMaze(unsigned long seed);
             void printMaze(int currXCell = -1, int currYCell = -1);
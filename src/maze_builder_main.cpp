@@ -0,0 +1,95 @@
+#include <algorithm>
+#include <ctime>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "maze_builder.h"
+#include "maze_memory.h"
+
+int main(int argc, char* argv[]) {
+    // Parse arguments
+    unsigned long seed = time(NULL);
+    unsigned int width = 21;
+    unsigned int height = 21;
+    std::string output = "maze.bmp";
+    std::string shape = mazeUtils::ClassicShape::name();
+    bool rle = true;
+    std::size_t budget = 0;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg(argv[i]);
+        const bool takesValue = arg == "-s" || arg == "--seed" || arg == "-w" || arg == "--width"
+            || arg == "-h" || arg == "--height" || arg == "-o" || arg == "--output"
+            || arg == "--shape" || arg == "--memory-budget";
+        if (takesValue && i + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << std::endl;
+            return 1;
+        }
+        try {
+            if (arg == "-s" || arg == "--seed") {
+                seed = std::stol(std::string(argv[++i]));
+            }
+            else if (arg == "-w" || arg == "--width") {
+                width = std::stoi(std::string(argv[++i]));
+            }
+            else if (arg == "-h" || arg == "--height") {
+                height = std::stoi(std::string(argv[++i]));
+            }
+            else if (arg == "-o" || arg == "--output") {
+                output = argv[++i];
+            }
+            else if (arg == "--no-rle") {
+                rle = false;
+            }
+            else if (arg == "--shape") {
+                shape = argv[++i];
+            }
+            else if (arg == "--memory-budget") {
+                budget = std::stoul(std::string(argv[++i])) * 1024 * 1024;
+            }
+        } catch (std::invalid_argument const& e) {
+            std::cerr << "Invalid number: " << argv[i] << std::endl;
+        } catch (std::out_of_range const& e) {
+            std::cerr << "Number out of range: " << argv[i] << std::endl;
+        }
+    }
+
+    auto shapes = mazeBuilder::DepthFirstBuilder::shapeNames();
+    if (std::find(shapes.begin(), shapes.end(), shape) == shapes.end()) {
+        std::cerr << "Unknown shape: " << shape << " (expected one of";
+        for (auto& name : shapes) std::cerr << " " << name;
+        std::cerr << ")" << std::endl;
+        return 1;
+    }
+
+    // Refuse up front rather than run out of budget halfway through
+    if (budget != 0) {
+        std::size_t estimate = mazeBuilder::DepthFirstBuilder::estimateBytes(width, height, shape);
+        if (estimate > budget) {
+            std::cerr << "Error - A " << width << " x " << height << " maze needs about "
+                      << mazeUtils::formatMegabytes(estimate) << ", over the "
+                      << mazeUtils::formatMegabytes(budget) << " memory budget" << std::endl;
+            return 1;
+        }
+        mazeUtils::memoryTracker().setBudget(budget);
+    }
+
+    try {
+        mazeBuilder::DepthFirstBuilder maze(seed, width, height, shape);
+        // Files ending in .maze are written in the native format, anything else as a BMP
+        const std::string nativeExtension = ".maze";
+        if (output.size() >= nativeExtension.size()
+            && output.compare(output.size() - nativeExtension.size(), nativeExtension.size(), nativeExtension) == 0) {
+            maze.makeNative(output, rle);
+        } else {
+            maze.makeImage(output);
+        }
+    } catch (std::exception const& e) {
+        std::cerr << "Error - " << e.what() << std::endl;
+        return 1;
+    }
+    std::cout << "  Memory: " << mazeUtils::memoryTracker().summary() << std::endl;
+    std::cout << "Maze created!" << std::endl;
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,396 @@
+#include "maze_format.h"
+
+#include "maze_png.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace mazeUtils {
+  namespace {
+    const char NATIVE_MAGIC[4] = { 'M', 'A', 'Z', 'E' };
+    const uint8_t ROW_PACKED = 0;
+    const uint8_t ROW_RLE = 1;
+
+    // Replays bytes that were already read while sniffing the format, then
+    // carries on with the rest of the stream.
+    class ReplayByteSource : public IByteSource {
+      public:
+        ReplayByteSource(std::vector<uint8_t> prefix, std::unique_ptr<IByteSource> rest)
+        : prefix(prefix), rest(std::move(rest)) {}
+
+        virtual std::size_t read(uint8_t* buffer, std::size_t size) {
+          if (position < prefix.size()) {
+            std::size_t count = std::min(size, prefix.size() - position);
+            std::memcpy(buffer, prefix.data() + position, count);
+            position += count;
+            return count;
+          }
+          return rest->read(buffer, size);
+        }
+      private:
+        std::vector<uint8_t> prefix;
+        std::size_t position = 0;
+        std::unique_ptr<IByteSource> rest;
+    };
+
+    uint32_t readLittleEndian32(const uint8_t* bytes) {
+      return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+    }
+
+    void writeLittleEndian32(std::ofstream& file, uint32_t value) {
+      char bytes[4] = { (char)value, (char)(value >> 8), (char)(value >> 16), (char)(value >> 24) };
+      file.write(bytes, 4);
+    }
+
+    void appendVarint(std::vector<uint8_t>& out, std::size_t value) {
+      while (value >= 0x80) {
+        out.push_back((value & 0x7f) | 0x80);
+        value >>= 7;
+      }
+      out.push_back(value);
+    }
+
+    // Sets pixels [start, start + length) in row
+    void openRange(PackedRow& row, std::size_t start, std::size_t length) {
+      std::size_t x = start;
+      const std::size_t stop = start + length;
+      while (x < stop) {
+        const std::size_t bit = x % BITS_PER_WORD;
+        const std::size_t count = std::min(BITS_PER_WORD - bit, stop - x);
+        const uint64_t mask = (count == BITS_PER_WORD ? ~uint64_t(0) : ((uint64_t(1) << count) - 1)) << bit;
+        row[x / BITS_PER_WORD] |= mask;
+        x += count;
+      }
+    }
+  }
+
+  FileByteSource::FileByteSource(std::string filePath)
+  : file(filePath, std::ios::binary) {}
+
+  bool FileByteSource::isOpen() {
+    return file.is_open();
+  }
+
+  std::size_t FileByteSource::read(uint8_t* buffer, std::size_t size) {
+    file.read(reinterpret_cast<char*>(buffer), size);
+    return file.gcount();
+  }
+
+  MemoryByteSource::MemoryByteSource(std::vector<uint8_t> bytes)
+  : bytes(std::move(bytes)) {}
+
+  std::size_t MemoryByteSource::read(uint8_t* buffer, std::size_t size) {
+    std::size_t count = std::min(size, bytes.size() - position);
+    std::memcpy(buffer, bytes.data() + position, count);
+    position += count;
+    return count;
+  }
+
+  ByteReader::ByteReader(IByteSource& source, std::size_t bufferSize)
+  : source(source),
+  buffer(bufferSize) {}
+
+  bool ByteReader::refill() {
+    position = 0;
+    filled = source.read(buffer.data(), buffer.size());
+    return filled > 0;
+  }
+
+  bool ByteReader::readExact(uint8_t* out, std::size_t size) {
+    while (size > 0) {
+      std::size_t count = read(out, size);
+      if (count == 0) return false;
+      out += count;
+      size -= count;
+    }
+    return true;
+  }
+
+  bool ByteReader::skip(std::size_t size) {
+    while (size > 0) {
+      if (position == filled && !refill()) return false;
+      std::size_t count = std::min(size, filled - position);
+      position += count;
+      size -= count;
+    }
+    return true;
+  }
+
+  std::size_t ByteReader::read(uint8_t* out, std::size_t size) {
+    if (position == filled && !refill()) return 0;
+    std::size_t count = std::min(size, filled - position);
+    std::memcpy(out, buffer.data() + position, count);
+    position += count;
+    return count;
+  }
+
+  NativeRowSource::NativeRowSource(std::unique_ptr<IByteSource> source)
+  : source(std::move(source)),
+  reader(*this->source) {
+    uint8_t header[16];
+    if (!reader.readExact(header, sizeof(header))) return;
+    if (std::memcmp(header, NATIVE_MAGIC, 4) != 0) return;
+    if (header[4] != NATIVE_FORMAT_VERSION) {
+      std::cout << "Error - Unsupported maze format version: " << (int)header[4] << std::endl;
+      return;
+    }
+    rowWidth = readLittleEndian32(header + 8);
+    rowCount = readLittleEndian32(header + 12);
+    open = true;
+  }
+
+  bool NativeRowSource::isOpen() {
+    return this->open;
+  }
+
+  std::size_t NativeRowSource::width() {
+    return this->rowWidth;
+  }
+
+  std::size_t NativeRowSource::height() {
+    return this->rowCount;
+  }
+
+  bool NativeRowSource::nextRow(PackedRow& row) {
+    if (!open || nextY >= rowCount) return false;
+
+    uint8_t tag;
+    if (!reader.readByte(tag)) {
+      error = "Maze file ended after " + std::to_string(nextY) + " rows";
+      return false;
+    }
+    row.assign(wordsForWidth(rowWidth), 0);
+    if (tag == ROW_PACKED) {
+      packed.resize((rowWidth + 7) / 8);
+      if (!reader.readExact(packed.data(), packed.size())) {
+        error = "Maze file ended in row " + std::to_string(nextY);
+        return false;
+      }
+      for (std::size_t i = 0; i < packed.size(); ++i) {
+        row[i / 8] |= uint64_t(packed[i]) << ((i % 8) * 8);
+      }
+      // Keep padding past the last pixel clear
+      if (rowWidth % BITS_PER_WORD) {
+        row.back() &= (uint64_t(1) << (rowWidth % BITS_PER_WORD)) - 1;
+      }
+    }
+    else if (tag == ROW_RLE) {
+      if (!readRuns(row)) {
+        error = "Corrupt run-length data in row " + std::to_string(nextY);
+        return false;
+      }
+    }
+    else {
+      error = "Unknown row encoding " + std::to_string(tag) + " in row " + std::to_string(nextY);
+      return false;
+    }
+    nextY++;
+    return true;
+  }
+
+  std::string NativeRowSource::getError() {
+    return this->error;
+  }
+
+  bool NativeRowSource::readRuns(PackedRow& row) {
+    std::size_t x = 0;
+    bool wall = true;
+    while (x < rowWidth) {
+      std::size_t length = 0;
+      int shift = 0;
+      uint8_t byte;
+      do {
+        if (!reader.readByte(byte) || shift > 56) return false;
+        length |= std::size_t(byte & 0x7f) << shift;
+        shift += 7;
+      } while (byte & 0x80);
+
+      if (length > rowWidth - x) return false;
+      if (!wall) openRange(row, x, length);
+      x += length;
+      wall = !wall;
+    }
+    return true;
+  }
+
+  NativeMazeWriter::NativeMazeWriter(std::string filePath, std::size_t width, std::size_t height, bool rle)
+  : file(filePath, std::ios::binary),
+  rowWidth(width),
+  rle(rle),
+  packed((width + 7) / 8)
+  {
+    if (!file) return;
+    file.write(NATIVE_MAGIC, 4);
+    char header[4] = { (char)NATIVE_FORMAT_VERSION, (char)(rle ? NATIVE_FLAG_RLE : 0), 0, 0 };
+    file.write(header, 4);
+    writeLittleEndian32(file, width);
+    writeLittleEndian32(file, height);
+  }
+
+  bool NativeMazeWriter::isOpen() {
+    return file.is_open() && file.good();
+  }
+
+  void NativeMazeWriter::writeRow(const PackedRow& row) {
+    for (std::size_t i = 0; i < packed.size(); ++i) {
+      packed[i] = row[i / 8] >> ((i % 8) * 8);
+    }
+
+    if (rle) {
+      // Alternate wall and open runs, starting with wall
+      runs.clear();
+      std::size_t x = 0;
+      bool wall = true;
+      while (x < rowWidth && runs.size() < packed.size()) {
+        std::size_t start = x;
+        while (x < rowWidth && mazeUtils::isOpen(row, x) != wall) x++;
+        appendVarint(runs, x - start);
+        wall = !wall;
+      }
+      if (x == rowWidth && runs.size() < packed.size()) {
+        file.put(ROW_RLE);
+        file.write(reinterpret_cast<const char*>(runs.data()), runs.size());
+        return;
+      }
+    }
+    file.put(ROW_PACKED);
+    file.write(reinterpret_cast<const char*>(packed.data()), packed.size());
+  }
+
+  bool NativeMazeWriter::close() {
+    file.close();
+    return !file.fail();
+  }
+
+  BmpRowSource::BmpRowSource(std::unique_ptr<IByteSource> source)
+  : source(std::move(source)),
+  reader(*this->source)
+  {
+    // File header, then the start of the BITMAPINFOHEADER
+    uint8_t header[34];
+    if (!reader.readExact(header, sizeof(header)) || header[0] != 'B' || header[1] != 'M') return;
+    const uint32_t dataOffset = readLittleEndian32(header + 10);
+    const int32_t width = readLittleEndian32(header + 18);
+    const int32_t height = readLittleEndian32(header + 22);
+    const unsigned int bitsPerPixel = header[28] | (header[29] << 8);
+    const uint32_t compression = readLittleEndian32(header + 30);
+
+    // Only plain RGB (or 32-bit with the standard bit fields) is supported
+    if ((bitsPerPixel != 24 && bitsPerPixel != 32) || (compression != 0 && compression != 3)
+        || width <= 0 || height == 0 || dataOffset < sizeof(header)) {
+      std::cout << "Error - Unsupported BMP: " << bitsPerPixel << " bits per pixel, compression " << compression << std::endl;
+      return;
+    }
+    if (!reader.skip(dataOffset - sizeof(header))) return;
+
+    imageWidth = width;
+    bottomUp = height > 0;
+    imageHeight = bottomUp ? height : -(int64_t)height;
+    bytesPerPixel = bitsPerPixel / 8;
+    open = true;
+  }
+
+  bool BmpRowSource::isOpen() {
+    return this->open;
+  }
+
+  std::size_t BmpRowSource::width() {
+    return this->imageWidth;
+  }
+
+  std::size_t BmpRowSource::height() {
+    return this->imageHeight;
+  }
+
+  std::size_t BmpRowSource::bufferBytes() {
+    return bottomUp ? imageHeight * wordsForWidth(imageWidth) * sizeof(uint64_t) : 0;
+  }
+
+  bool BmpRowSource::nextRow(PackedRow& row) {
+    if (!open || nextY >= imageHeight) return false;
+
+    const std::size_t words = wordsForWidth(imageWidth);
+    row.assign(words, 0);
+    if (!bottomUp) {
+      if (!readRow(row.data())) return false;
+    }
+    else {
+      if (bufferedRows.empty()) {
+        // The first row in the file is the bottom of the maze
+        bufferedRows.assign(imageHeight * words, 0);
+        for (std::size_t i = imageHeight; i-- > 0;) {
+          if (!readRow(&bufferedRows[i * words])) {
+            TrackedVector<uint64_t>().swap(bufferedRows);
+            return false;
+          }
+        }
+      }
+      std::copy(bufferedRows.begin() + nextY * words, bufferedRows.begin() + (nextY + 1) * words, row.begin());
+    }
+    nextY++;
+    if (nextY == imageHeight) TrackedVector<uint64_t>().swap(bufferedRows);
+    return true;
+  }
+
+  std::string BmpRowSource::getError() {
+    return this->error;
+  }
+
+  bool BmpRowSource::readRow(uint64_t* words) {
+    // Rows are padded to a multiple of four bytes
+    pixels.resize((imageWidth * bytesPerPixel + 3) & ~std::size_t(3));
+    if (!reader.readExact(pixels.data(), pixels.size())) {
+      error = "BMP pixel data ended early";
+      return false;
+    }
+    for (std::size_t x = 0; x < imageWidth; ++x) {
+      const uint8_t* pixel = &pixels[x * bytesPerPixel];
+      if (pixel[0] == 255 && pixel[1] == 255 && pixel[2] == 255) {
+        words[x / BITS_PER_WORD] |= uint64_t(1) << (x % BITS_PER_WORD);
+      }
+    }
+    return true;
+  }
+
+  std::unique_ptr<IRowSource> decodeRowSource(std::unique_ptr<IByteSource> source) {
+    // Sniff the signature, then hand the decoder a stream that starts over
+    std::vector<uint8_t> signature(8);
+    std::size_t got = 0;
+    while (got < signature.size()) {
+      std::size_t count = source->read(signature.data() + got, signature.size() - got);
+      if (count == 0) break;
+      got += count;
+    }
+    signature.resize(got);
+    std::unique_ptr<IByteSource> replay(new ReplayByteSource(signature, std::move(source)));
+
+    if (got >= 4 && std::memcmp(signature.data(), NATIVE_MAGIC, 4) == 0) {
+      std::unique_ptr<NativeRowSource> native(new NativeRowSource(std::move(replay)));
+      if (native->isOpen()) return native;
+    }
+    else if (got == 8 && PngRowSource::isSignature(signature.data())) {
+      std::unique_ptr<PngRowSource> png(new PngRowSource(std::move(replay)));
+      if (png->isOpen()) return png;
+    }
+    else if (got >= 2 && signature[0] == 'B' && signature[1] == 'M') {
+      std::unique_ptr<BmpRowSource> bmp(new BmpRowSource(std::move(replay)));
+      if (bmp->isOpen()) return bmp;
+    }
+    return NULL;
+  }
+
+  bool readMazeSize(std::string filePath, std::size_t& width, std::size_t& height, std::size_t& bufferBytes) {
+    std::unique_ptr<FileByteSource> file(new FileByteSource(filePath));
+    if (!file->isOpen()) return false;
+    // The decoders only read their headers until the first row is asked
+    // for, and size their row buffers then, so a hostile header can't make
+    // this allocate anything
+    std::unique_ptr<IRowSource> rows = decodeRowSource(std::move(file));
+    if (!rows) return false;
+    width = rows->width();
+    height = rows->height();
+    bufferBytes = rows->bufferBytes();
+    return true;
+  }
+}
@@ -0,0 +1,161 @@
+#pragma once
+
+#include "maze_memory.h"
+#include "maze_rows.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace mazeUtils {
+  // A stream of bytes that decoders pull from, e.g. a file on disk.
+  class IByteSource {
+    public:
+      virtual ~IByteSource() {}
+
+      // Reads up to size bytes into buffer. Returns the number of bytes
+      // read, which is only 0 at the end of the stream.
+      virtual std::size_t read(uint8_t* buffer, std::size_t size) = 0;
+  };
+
+  class FileByteSource : public IByteSource {
+    public:
+      FileByteSource(std::string filePath);
+
+      bool isOpen();
+      virtual std::size_t read(uint8_t* buffer, std::size_t size);
+    private:
+      std::ifstream file;
+  };
+
+  class MemoryByteSource : public IByteSource {
+    public:
+      MemoryByteSource(std::vector<uint8_t> bytes);
+
+      virtual std::size_t read(uint8_t* buffer, std::size_t size);
+    private:
+      std::vector<uint8_t> bytes;
+      std::size_t position = 0;
+  };
+
+  // Buffers an IByteSource so decoders can cheaply read a byte at a time.
+  class ByteReader {
+    public:
+      ByteReader(IByteSource& source, std::size_t bufferSize = 1 << 16);
+
+      // Returns false at the end of the stream
+      bool readByte(uint8_t& byte) {
+        if (position == filled && !refill()) return false;
+        byte = buffer[position++];
+        return true;
+      }
+      // Returns false if the stream ends before size bytes were read
+      bool readExact(uint8_t* out, std::size_t size);
+      bool skip(std::size_t size);
+      // Reads up to size bytes. Returns 0 only at the end of the stream.
+      std::size_t read(uint8_t* out, std::size_t size);
+    private:
+      IByteSource& source;
+      std::vector<uint8_t> buffer;
+      std::size_t position = 0;
+      std::size_t filled = 0;
+
+      bool refill();
+  };
+
+  // The native maze format is a 1-bit packed grid, with each row optionally
+  // run-length encoded:
+  //
+  //   "MAZE" version:u8 flags:u8 reserved:u16 width:u32le height:u32le
+  //   then for each row, top to bottom, a tag byte followed by either
+  //     0 (packed): ceil(width / 8) bytes, bit (x % 8) of byte (x / 8) set for open pixels
+  //     1 (RLE):    varint run lengths alternating wall, open, wall, ...
+  //                 starting with a (possibly empty) wall run, totalling width
+  const uint8_t NATIVE_FORMAT_VERSION = 1;
+  const uint8_t NATIVE_FLAG_RLE = 0x01;
+
+  // Streams rows out of a native maze file as they're decoded.
+  class NativeRowSource : public IRowSource {
+    public:
+      NativeRowSource(std::unique_ptr<IByteSource> source);
+
+      bool isOpen();
+      virtual std::size_t width();
+      virtual std::size_t height();
+      virtual bool nextRow(PackedRow& row);
+      virtual std::string getError();
+    private:
+      std::unique_ptr<IByteSource> source;
+      ByteReader reader;
+      bool open = false;
+      std::string error;
+      std::size_t rowWidth = 0;
+      std::size_t rowCount = 0;
+      std::size_t nextY = 0;
+      // Sized on the first packed row
+      TrackedVector<uint8_t> packed;
+
+      bool readRuns(PackedRow& row);
+  };
+
+  // Writes a maze in the native format one row at a time. With rle set,
+  // each row is written with whichever encoding is smaller.
+  class NativeMazeWriter {
+    public:
+      NativeMazeWriter(std::string filePath, std::size_t width, std::size_t height, bool rle = true);
+
+      bool isOpen();
+      void writeRow(const PackedRow& row);
+      // Returns false if anything failed to write
+      bool close();
+    private:
+      std::ofstream file;
+      std::size_t rowWidth;
+      bool rle;
+      std::vector<uint8_t> packed;
+      std::vector<uint8_t> runs;
+  };
+
+  // Streams rows out of an uncompressed 24 or 32-bit BMP. Bottom-up images
+  // (the usual kind) store their top row last, so those are decoded into
+  // packed rows in full on the first call to nextRow, at one bit per pixel.
+  class BmpRowSource : public IRowSource {
+    public:
+      BmpRowSource(std::unique_ptr<IByteSource> source);
+
+      bool isOpen();
+      virtual std::size_t width();
+      virtual std::size_t height();
+      virtual bool nextRow(PackedRow& row);
+      virtual std::size_t bufferBytes();
+      virtual std::string getError();
+    private:
+      std::unique_ptr<IByteSource> source;
+      ByteReader reader;
+      bool open = false;
+      std::string error;
+      bool bottomUp = true;
+      std::size_t imageWidth = 0;
+      std::size_t imageHeight = 0;
+      std::size_t bytesPerPixel = 3;
+      std::size_t nextY = 0;
+      // One row of the file, sized on the first read
+      TrackedVector<uint8_t> pixels;
+      // Every row of a bottom-up image, top row first
+      TrackedVector<uint64_t> bufferedRows;
+
+      bool readRow(uint64_t* words);
+  };
+
+  // Picks a decoder for an arbitrary byte stream by sniffing its first
+  // bytes. Supports the native format, PNG and BMP. Returns NULL for anything else.
+  std::unique_ptr<IRowSource> decodeRowSource(std::unique_ptr<IByteSource> source);
+
+  // Finds the size of the maze in filePath from its header, without
+  // decoding any rows, along with what its decoder will buffer (see
+  // IRowSource::bufferBytes). Returns false if the file can't be decoded.
+  bool readMazeSize(std::string filePath, std::size_t& width, std::size_t& height, std::size_t& bufferBytes);
+}
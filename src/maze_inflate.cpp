@@ -0,0 +1,265 @@
+#include "maze_inflate.h"
+
+#include <stdexcept>
+
+namespace mazeUtils {
+  namespace {
+    const std::size_t WINDOW_SIZE = 1 << 15;
+
+    const uint16_t LENGTH_BASE[29] = {
+      3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+      35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+    };
+    const uint8_t LENGTH_EXTRA[29] = {
+      0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+      3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+    };
+    const uint16_t DISTANCE_BASE[30] = {
+      1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+      257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+    };
+    const uint8_t DISTANCE_EXTRA[30] = {
+      0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+      7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+    };
+    // Order in which code length code lengths are stored
+    const uint8_t CODE_LENGTH_ORDER[19] = {
+      16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+    };
+
+    std::runtime_error corrupt(const char* what) {
+      return std::runtime_error(std::string("Corrupt compressed data: ") + what);
+    }
+  }
+
+  void Inflater::HuffmanTable::build(const uint8_t* lengths, std::size_t count) {
+    unsigned int lengthCounts[16] = {0};
+    maxBits = 0;
+    for (std::size_t i = 0; i < count; ++i) {
+      lengthCounts[lengths[i]]++;
+      if (lengths[i] > maxBits) maxBits = lengths[i];
+    }
+    lengthCounts[0] = 0;
+    // An empty code is allowed (e.g. no distance codes); any lookup fails.
+    if (maxBits == 0) maxBits = 1;
+
+    // First canonical code of each length
+    unsigned int nextCode[16] = {0};
+    unsigned int code = 0;
+    for (unsigned int bits = 1; bits < 16; ++bits) {
+      code = (code + lengthCounts[bits - 1]) << 1;
+      nextCode[bits] = code;
+    }
+
+    entries.assign(std::size_t(1) << maxBits, 0);
+    for (std::size_t symbol = 0; symbol < count; ++symbol) {
+      unsigned int length = lengths[symbol];
+      if (length == 0) continue;
+      // Codes are sent most significant bit first, but we read bits least
+      // significant first, so index the table by the reversed code.
+      unsigned int value = nextCode[length]++;
+      if (value >= (1u << length)) throw corrupt("over-subscribed Huffman code");
+      unsigned int reversed = 0;
+      for (unsigned int bit = 0; bit < length; ++bit) {
+        reversed = (reversed << 1) | ((value >> bit) & 1);
+      }
+      for (std::size_t i = reversed; i < entries.size(); i += std::size_t(1) << length) {
+        entries[i] = (symbol << 4) | length;
+      }
+    }
+  }
+
+  Inflater::Inflater(IByteSource& source, bool zlibHeader)
+  : input(source),
+  window(WINDOW_SIZE)
+  {
+    if (zlibHeader) {
+      unsigned int cmf = getBits(8);
+      unsigned int flags = getBits(8);
+      if ((cmf & 0x0f) != 8 || ((cmf << 8) | flags) % 31 != 0) throw corrupt("bad zlib header");
+      if (flags & 0x20) throw corrupt("preset dictionaries are not supported");
+    }
+  }
+
+  void Inflater::needBits(unsigned int count) {
+    while (bitCount < count) {
+      uint8_t byte = 0;
+      if (!input.readByte(byte)) paddingBits += 8;
+      bitBuffer |= uint64_t(byte) << bitCount;
+      bitCount += 8;
+    }
+  }
+
+  void Inflater::dropBits(unsigned int count) {
+    bitBuffer >>= count;
+    bitCount -= count;
+    if (paddingBits > bitCount) throw corrupt("unexpected end of stream");
+  }
+
+  unsigned int Inflater::getBits(unsigned int count) {
+    if (count == 0) return 0;
+    needBits(count);
+    unsigned int value = bitBuffer & ((uint64_t(1) << count) - 1);
+    dropBits(count);
+    return value;
+  }
+
+  unsigned int Inflater::decode(const HuffmanTable& table) {
+    needBits(table.maxBits);
+    uint16_t entry = table.entries[bitBuffer & ((uint64_t(1) << table.maxBits) - 1)];
+    unsigned int length = entry & 0x0f;
+    if (length == 0) throw corrupt("invalid Huffman code");
+    dropBits(length);
+    return entry >> 4;
+  }
+
+  void Inflater::readFixedTables() {
+    uint8_t lengths[288];
+    for (int i = 0; i < 144; ++i) lengths[i] = 8;
+    for (int i = 144; i < 256; ++i) lengths[i] = 9;
+    for (int i = 256; i < 280; ++i) lengths[i] = 7;
+    for (int i = 280; i < 288; ++i) lengths[i] = 8;
+    literals.build(lengths, 288);
+    for (int i = 0; i < 30; ++i) lengths[i] = 5;
+    distances.build(lengths, 30);
+  }
+
+  void Inflater::readDynamicTables() {
+    const unsigned int literalCount = getBits(5) + 257;
+    const unsigned int distanceCount = getBits(5) + 1;
+    const unsigned int codeLengthCount = getBits(4) + 4;
+    if (literalCount > 286 || distanceCount > 30) throw corrupt("too many codes");
+
+    uint8_t codeLengthLengths[19] = {0};
+    for (unsigned int i = 0; i < codeLengthCount; ++i) {
+      codeLengthLengths[CODE_LENGTH_ORDER[i]] = getBits(3);
+    }
+    HuffmanTable codeLengths;
+    codeLengths.build(codeLengthLengths, 19);
+
+    // Literal/length and distance code lengths are sent as one sequence
+    uint8_t lengths[286 + 30] = {0};
+    unsigned int index = 0;
+    while (index < literalCount + distanceCount) {
+      unsigned int symbol = decode(codeLengths);
+      if (symbol < 16) {
+        lengths[index++] = symbol;
+        continue;
+      }
+      uint8_t repeated = 0;
+      unsigned int repeat = 0;
+      if (symbol == 16) {
+        if (index == 0) throw corrupt("repeat with no previous length");
+        repeated = lengths[index - 1];
+        repeat = 3 + getBits(2);
+      }
+      else if (symbol == 17) {
+        repeat = 3 + getBits(3);
+      }
+      else {
+        repeat = 11 + getBits(7);
+      }
+      if (index + repeat > literalCount + distanceCount) throw corrupt("too many code lengths");
+      while (repeat--) lengths[index++] = repeated;
+    }
+    if (lengths[256] == 0) throw corrupt("no end-of-block code");
+
+    literals.build(lengths, literalCount);
+    distances.build(lengths + literalCount, distanceCount);
+  }
+
+  void Inflater::startBlock() {
+    if (lastBlock) {
+      state = finished;
+      return;
+    }
+    lastBlock = getBits(1);
+    switch (getBits(2)) {
+      case 0: {
+        // Stored blocks start on a byte boundary
+        dropBits(bitCount % 8);
+        unsigned int length = getBits(16);
+        unsigned int complement = getBits(16);
+        if (length != (~complement & 0xffff)) throw corrupt("stored block length mismatch");
+        storedRemaining = length;
+        state = storedBlock;
+        break;
+      }
+      case 1:
+        readFixedTables();
+        state = codedBlock;
+        break;
+      case 2:
+        readDynamicTables();
+        state = codedBlock;
+        break;
+      default:
+        throw corrupt("invalid block type");
+    }
+  }
+
+  std::size_t Inflater::read(uint8_t* out, std::size_t size) {
+    std::size_t produced = 0;
+    auto emit = [&](uint8_t byte) {
+      out[produced++] = byte;
+      window[windowPosition] = byte;
+      windowPosition = (windowPosition + 1) & (WINDOW_SIZE - 1);
+      totalOut++;
+    };
+
+    while (produced < size) {
+      // Finish any back-reference copy left over from the last call
+      if (copyLength > 0) {
+        emit(window[(windowPosition - copyDistance) & (WINDOW_SIZE - 1)]);
+        copyLength--;
+        continue;
+      }
+
+      switch (state) {
+        case blockHeader:
+          startBlock();
+          break;
+        case storedBlock:
+          if (storedRemaining == 0) {
+            state = blockHeader;
+            break;
+          }
+          emit(getBits(8));
+          storedRemaining--;
+          break;
+        case codedBlock: {
+          unsigned int symbol = decode(literals);
+          if (symbol < 256) {
+            emit(symbol);
+            break;
+          }
+          if (symbol == 256) {
+            state = blockHeader;
+            break;
+          }
+          symbol -= 257;
+          if (symbol >= 29) throw corrupt("invalid length code");
+          copyLength = LENGTH_BASE[symbol] + getBits(LENGTH_EXTRA[symbol]);
+          unsigned int distanceSymbol = decode(distances);
+          if (distanceSymbol >= 30) throw corrupt("invalid distance code");
+          copyDistance = DISTANCE_BASE[distanceSymbol] + getBits(DISTANCE_EXTRA[distanceSymbol]);
+          if (copyDistance > totalOut) throw corrupt("distance reaches before start of stream");
+          break;
+        }
+        case finished:
+          return produced;
+      }
+    }
+    return produced;
+  }
+
+  bool Inflater::readExact(uint8_t* out, std::size_t size) {
+    while (size > 0) {
+      std::size_t count = read(out, size);
+      if (count == 0) return false;
+      out += count;
+      size -= count;
+    }
+    return true;
+  }
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "maze_format.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace mazeUtils {
+  // A small streaming DEFLATE decoder (RFC 1951), so compressed maze images
+  // can be read without any third-party libraries. Output is produced on
+  // demand, keeping only the 32KB history window in memory.
+  class Inflater {
+    public:
+      // With zlibHeader set, the two-byte zlib header (RFC 1950) is checked
+      // and skipped first. The trailing checksum is not verified.
+      Inflater(IByteSource& source, bool zlibHeader = false);
+
+      // Decompresses up to size bytes into out. Returns the number of bytes
+      // produced, which is only 0 at the end of the stream. Throws
+      // std::runtime_error on corrupt or truncated data.
+      std::size_t read(uint8_t* out, std::size_t size);
+      bool readExact(uint8_t* out, std::size_t size);
+    private:
+      // Canonical Huffman code, decoded with a single lookup table indexed
+      // by the next maxBits input bits. Entries are (symbol << 4) | length.
+      struct HuffmanTable {
+        std::vector<uint16_t> entries;
+        unsigned int maxBits = 0;
+
+        void build(const uint8_t* lengths, std::size_t count);
+      };
+
+      enum State {
+        blockHeader,
+        storedBlock,
+        codedBlock,
+        finished
+      };
+
+      ByteReader input;
+      uint64_t bitBuffer = 0;
+      unsigned int bitCount = 0;
+      // Zero bits appended past the end of the input, so a lookup near the
+      // end of the stream can peek ahead. Consuming any of them is an error.
+      unsigned int paddingBits = 0;
+
+      State state = blockHeader;
+      bool lastBlock = false;
+      std::size_t storedRemaining = 0;
+      HuffmanTable literals;
+      HuffmanTable distances;
+
+      std::vector<uint8_t> window;
+      std::size_t windowPosition = 0;
+      std::size_t totalOut = 0;
+      std::size_t copyLength = 0;
+      std::size_t copyDistance = 0;
+
+      void needBits(unsigned int count);
+      void dropBits(unsigned int count);
+      unsigned int getBits(unsigned int count);
+      unsigned int decode(const HuffmanTable& table);
+      void startBlock();
+      void readDynamicTables();
+      void readFixedTables();
+  };
+}
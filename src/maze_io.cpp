@@ -0,0 +1,303 @@
+#include "maze_io.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <iostream>
+#include <map>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#define MAZE_HAVE_IO_URING 1
+#endif
+
+#ifdef DEBUG
+#define LOG(x) std::cout << x << std::endl;
+#else
+#define LOG(x)
+#endif
+
+namespace mazeUtils {
+  namespace {
+    typedef std::chrono::steady_clock Clock;
+
+    uint64_t nanosecondsSince(Clock::time_point t1) {
+      return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - t1).count();
+    }
+
+    // Fills buffer[done, size) from offset + done. Returns false on error.
+    bool preadFully(int fd, uint8_t* buffer, std::size_t size, uint64_t offset, std::size_t done = 0) {
+      while (done < size) {
+        ssize_t got = pread(fd, buffer + done, size - done, offset + done);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) return false;
+        done += got;
+      }
+      return true;
+    }
+
+    // Opens filePath and returns its size, or -1 on failure
+    int openForReading(std::string filePath, uint64_t& size) {
+      int fd = open(filePath.c_str(), O_RDONLY);
+      if (fd < 0) return -1;
+      struct stat info;
+      if (fstat(fd, &info) != 0) {
+        close(fd);
+        return -1;
+      }
+      size = info.st_size;
+      return fd;
+    }
+  }
+
+  double IBlockReader::getIoSeconds() {
+    return ioNanoseconds / 1000000000.0;
+  }
+
+  std::string PreadBlockReader::name() {
+    return "pread";
+  }
+
+  int PreadBlockReader::readFile(std::string filePath, std::size_t blockSize, const BlockHandler& handler) {
+    uint64_t size = 0;
+    int fd = openForReading(filePath, size);
+    if (fd < 0) return 1;
+
+    int result = 0;
+    for (uint64_t offset = 0; offset < size; offset += blockSize) {
+      std::vector<uint8_t> block(std::min<uint64_t>(blockSize, size - offset));
+      auto t1 = Clock::now();
+      bool ok = preadFully(fd, block.data(), block.size(), offset);
+      ioNanoseconds += nanosecondsSince(t1);
+      if (!ok || !handler(block)) {
+        result = 1;
+        break;
+      }
+    }
+    close(fd);
+    return result;
+  }
+
+#ifdef MAZE_HAVE_IO_URING
+  // The shared submission and completion rings, mapped from the kernel
+  struct IoUringBlockReader::Ring {
+    int fd = -1;
+    unsigned int depth = 0;
+    void* sqMap = MAP_FAILED;
+    std::size_t sqMapSize = 0;
+    void* cqMap = MAP_FAILED;
+    std::size_t cqMapSize = 0;
+    io_uring_sqe* sqes = (io_uring_sqe*)MAP_FAILED;
+    std::size_t sqesSize = 0;
+
+    unsigned int* sqTail;
+    unsigned int* sqMask;
+    unsigned int* sqArray;
+    unsigned int* cqHead;
+    unsigned int* cqTail;
+    unsigned int* cqMask;
+    io_uring_cqe* cqes;
+
+    ~Ring() {
+      if (sqes != MAP_FAILED) munmap(sqes, sqesSize);
+      if (cqMap != MAP_FAILED && cqMap != sqMap) munmap(cqMap, cqMapSize);
+      if (sqMap != MAP_FAILED) munmap(sqMap, sqMapSize);
+      if (fd >= 0) close(fd);
+    }
+
+    void queueRead(int fileFd, uint8_t* buffer, unsigned int length, uint64_t offset, uint64_t userData) {
+      unsigned int tail = *sqTail;
+      unsigned int index = tail & *sqMask;
+      io_uring_sqe* sqe = &sqes[index];
+      *sqe = io_uring_sqe();
+      sqe->opcode = IORING_OP_READ;
+      sqe->fd = fileFd;
+      sqe->addr = (uint64_t)(uintptr_t)buffer;
+      sqe->len = length;
+      sqe->off = offset;
+      sqe->user_data = userData;
+      sqArray[index] = index;
+      __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+    }
+
+    // Takes back the last count queued reads. Only safe for reads that
+    // io_uring_enter hasn't accepted yet.
+    void unqueue(unsigned int count) {
+      __atomic_store_n(sqTail, *sqTail - count, __ATOMIC_RELEASE);
+    }
+
+    // Returns the number of queued reads the kernel accepted, or -1
+    int enter(unsigned int submit, unsigned int waitFor) {
+      int result;
+      do {
+        result = syscall(__NR_io_uring_enter, fd, submit, waitFor, waitFor ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+      } while (result < 0 && errno == EINTR);
+      return result;
+    }
+  };
+
+  std::unique_ptr<IoUringBlockReader> IoUringBlockReader::create(unsigned int depth) {
+    std::unique_ptr<Ring> ring(new Ring());
+    io_uring_params params = io_uring_params();
+    ring->fd = syscall(__NR_io_uring_setup, depth, &params);
+    if (ring->fd < 0) {
+      LOG("io_uring unavailable, errno " << errno);
+      return NULL;
+    }
+    ring->depth = params.sq_entries;
+
+    ring->sqMapSize = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+    ring->cqMapSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool singleMap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (singleMap) {
+      ring->sqMapSize = ring->cqMapSize = std::max(ring->sqMapSize, ring->cqMapSize);
+    }
+    ring->sqMap = mmap(NULL, ring->sqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    if (ring->sqMap == MAP_FAILED) return NULL;
+    ring->cqMap = singleMap ? ring->sqMap
+      : mmap(NULL, ring->cqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+    if (ring->cqMap == MAP_FAILED) return NULL;
+    ring->sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    ring->sqes = (io_uring_sqe*)mmap(NULL, ring->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) return NULL;
+
+    char* sq = (char*)ring->sqMap;
+    char* cq = (char*)ring->cqMap;
+    ring->sqTail = (unsigned int*)(sq + params.sq_off.tail);
+    ring->sqMask = (unsigned int*)(sq + params.sq_off.ring_mask);
+    ring->sqArray = (unsigned int*)(sq + params.sq_off.array);
+    ring->cqHead = (unsigned int*)(cq + params.cq_off.head);
+    ring->cqTail = (unsigned int*)(cq + params.cq_off.tail);
+    ring->cqMask = (unsigned int*)(cq + params.cq_off.ring_mask);
+    ring->cqes = (io_uring_cqe*)(cq + params.cq_off.cqes);
+
+    return std::unique_ptr<IoUringBlockReader>(new IoUringBlockReader(std::move(ring)));
+  }
+
+  int IoUringBlockReader::readFile(std::string filePath, std::size_t blockSize, const BlockHandler& handler) {
+    uint64_t size = 0;
+    int fd = openForReading(filePath, size);
+    if (fd < 0) return 1;
+
+    const uint64_t blockCount = (size + blockSize - 1) / blockSize;
+    // Blocks that are in flight, or have arrived ahead of an earlier block.
+    // Map nodes never move, so the kernel can safely write into them.
+    struct Pending {
+      std::vector<uint8_t> buffer;
+      bool complete = false;
+    };
+    std::map<uint64_t, Pending> pending;
+    uint64_t nextToSubmit = 0;
+    uint64_t nextToDeliver = 0;
+    // Reads the kernel has accepted but that haven't completed yet
+    unsigned int inFlight = 0;
+    // Reads queued in the ring that the kernel hasn't accepted yet
+    unsigned int unsubmitted = 0;
+    int result = 0;
+
+    auto reap = [&]() {
+      unsigned int head = *ring->cqHead;
+      unsigned int tail = __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE);
+      for (; head != tail; ++head) {
+        const io_uring_cqe& cqe = ring->cqes[head & *ring->cqMask];
+        Pending& block = pending[cqe.user_data];
+        std::size_t done = cqe.res > 0 ? cqe.res : 0;
+        // Finish short or failed reads the simple way
+        if (done < block.buffer.size()
+            && !preadFully(fd, block.buffer.data(), block.buffer.size(), cqe.user_data * blockSize, done)) {
+          result = 1;
+        }
+        block.complete = true;
+        inFlight--;
+      }
+      __atomic_store_n(ring->cqHead, head, __ATOMIC_RELEASE);
+    };
+
+    while (nextToDeliver < blockCount && result == 0) {
+      // Keep the ring full
+      while (inFlight + unsubmitted < ring->depth && nextToSubmit < blockCount) {
+        Pending& block = pending[nextToSubmit];
+        block.buffer.resize(std::min<uint64_t>(blockSize, size - nextToSubmit * blockSize));
+        ring->queueRead(fd, block.buffer.data(), block.buffer.size(), nextToSubmit * blockSize, nextToSubmit);
+        nextToSubmit++;
+        unsubmitted++;
+      }
+
+      // The kernel may accept only some of the reads, in which case it
+      // returns without waiting and the rest go in with the next call
+      auto t1 = Clock::now();
+      int submitted = ring->enter(unsubmitted, 1);
+      if (submitted < 0 || (submitted == 0 && unsubmitted > 0)) {
+        ioNanoseconds += nanosecondsSince(t1);
+        result = 1;
+        break;
+      }
+      unsubmitted -= submitted;
+      inFlight += submitted;
+      reap();
+      ioNanoseconds += nanosecondsSince(t1);
+
+      // Hand over everything that's now contiguous
+      while (result == 0) {
+        auto ready = pending.find(nextToDeliver);
+        if (ready == pending.end() || !ready->second.complete) break;
+        if (!handler(ready->second.buffer)) result = 1;
+        pending.erase(ready);
+        nextToDeliver++;
+      }
+    }
+
+    // Reads the kernel never took mustn't be picked up by the next file
+    ring->unqueue(unsubmitted);
+    // Don't free any buffer the kernel may still be writing to
+    while (inFlight > 0) {
+      if (ring->enter(0, 1) < 0) break;
+      reap();
+    }
+    close(fd);
+    return result;
+  }
+
+  IoUringBlockReader::IoUringBlockReader(std::unique_ptr<Ring> ring)
+  : ring(std::move(ring)) {}
+
+  IoUringBlockReader::~IoUringBlockReader() {}
+
+  std::string IoUringBlockReader::name() {
+    return "io_uring";
+  }
+#else
+  struct IoUringBlockReader::Ring {};
+
+  std::unique_ptr<IoUringBlockReader> IoUringBlockReader::create(unsigned int depth) {
+    return NULL;
+  }
+
+  IoUringBlockReader::IoUringBlockReader(std::unique_ptr<Ring> ring)
+  : ring(std::move(ring)) {}
+
+  IoUringBlockReader::~IoUringBlockReader() {}
+
+  std::string IoUringBlockReader::name() {
+    return "io_uring";
+  }
+
+  int IoUringBlockReader::readFile(std::string filePath, std::size_t blockSize, const BlockHandler& handler) {
+    return 1;
+  }
+#endif
+
+  std::unique_ptr<IBlockReader> createBlockReader(bool preferIoUring) {
+    if (preferIoUring) {
+      std::unique_ptr<IBlockReader> uring = IoUringBlockReader::create();
+      if (uring) return uring;
+    }
+    return std::unique_ptr<IBlockReader>(new PreadBlockReader());
+  }
+}
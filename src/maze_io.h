@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace mazeUtils {
+  // Reads a whole file as a sequence of fixed-size blocks, handed over in
+  // file order as they arrive.
+  class IBlockReader {
+    public:
+      // Takes ownership of the block's contents. Returns false to stop reading.
+      typedef std::function<bool(std::vector<uint8_t>& block)> BlockHandler;
+
+      virtual ~IBlockReader() {}
+
+      virtual std::string name() = 0;
+      // Returns 0 once every block has been handed over, or non-zero if the
+      // file couldn't be read or the handler stopped early.
+      virtual int readFile(std::string filePath, std::size_t blockSize, const BlockHandler& handler) = 0;
+      // Time spent waiting on the disk so far
+      double getIoSeconds();
+    protected:
+      uint64_t ioNanoseconds = 0;
+  };
+
+  // One blocking pread at a time. Works everywhere.
+  class PreadBlockReader : public IBlockReader {
+    public:
+      virtual std::string name();
+      virtual int readFile(std::string filePath, std::size_t blockSize, const BlockHandler& handler);
+  };
+
+  // Keeps several reads in flight through io_uring, talking to the kernel
+  // directly so liburing isn't needed. Blocks that fail or come back short
+  // are finished off with pread.
+  class IoUringBlockReader : public IBlockReader {
+    public:
+      // Returns NULL if io_uring isn't available (old kernel, or blocked by
+      // a seccomp policy as in many containers).
+      static std::unique_ptr<IoUringBlockReader> create(unsigned int depth = 8);
+      virtual ~IoUringBlockReader();
+
+      virtual std::string name();
+      virtual int readFile(std::string filePath, std::size_t blockSize, const BlockHandler& handler);
+    private:
+      struct Ring;
+
+      IoUringBlockReader(std::unique_ptr<Ring> ring);
+      std::unique_ptr<Ring> ring;
+  };
+
+  // io_uring when asked for and available, pread otherwise
+  std::unique_ptr<IBlockReader> createBlockReader(bool preferIoUring);
+}
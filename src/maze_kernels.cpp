@@ -0,0 +1,93 @@
+#include "maze_kernels.h"
+
+#include "maze_bitsolver.h"
+#include "maze_utils.h"
+
+namespace mazeUtils {
+  namespace {
+    // Four-connected shapes are flooded on their lattice, which the classic
+    // shape already is, so it skips sampling and mapping the path back
+    template <class Shape>
+    struct Lattice {
+      static int load(BitGridSolver& solver, IRowSource& rows) {
+        LatticeRowSource<Shape> lattice(rows);
+        return solver.load(lattice);
+      }
+
+      static void toPixels(BitGridSolver& solver) {
+        solver.mapPathToPixels<Shape>();
+      }
+    };
+
+    template <>
+    struct Lattice<ClassicShape> {
+      static int load(BitGridSolver& solver, IRowSource& rows) {
+        return solver.load(rows);
+      }
+
+      static void toPixels(BitGridSolver&) {}
+    };
+
+    template <class Shape, Connectivity C = Shape::connectivity>
+    struct GridKernels {
+      static int load(BitGridSolver& solver, IRowSource& rows) {
+        return Lattice<Shape>::load(solver, rows);
+      }
+
+      static bool solve(BitGridSolver& solver) {
+        if (!solver.solveWith<C>()) return false;
+        Lattice<Shape>::toPixels(solver);
+        return true;
+      }
+
+      static int parse(MazeNetwork& network, IRowSource& rows) {
+        return network.parse<Shape>(rows);
+      }
+
+      static SolverKernels entry() {
+        return { Shape::name(), C, &Shape::fits, &load, &solve, &parse };
+      }
+    };
+
+    // Eight-connected diagonals don't survive sampling, so those shapes are
+    // flooded at full resolution
+    template <class Shape>
+    struct GridKernels<Shape, eightConnected> {
+      static int load(BitGridSolver& solver, IRowSource& rows) {
+        if (!Shape::fits(rows.width(), rows.height())) return 1;
+        return solver.load(rows);
+      }
+
+      static bool solve(BitGridSolver& solver) {
+        return solver.solveWith<eightConnected>();
+      }
+
+      static int parse(MazeNetwork& network, IRowSource& rows) {
+        return network.parse<Shape>(rows);
+      }
+
+      static SolverKernels entry() {
+        return { Shape::name(), eightConnected, &Shape::fits, &load, &solve, &parse };
+      }
+    };
+  }
+
+  const std::vector<SolverKernels>& solverKernelTable() {
+    static const std::vector<SolverKernels> table = []() {
+      std::vector<SolverKernels> entries;
+      forEachShape([&](auto shape) {
+        entries.push_back(GridKernels<decltype(shape)>::entry());
+      });
+      return entries;
+    }();
+    return table;
+  }
+
+  const SolverKernels* findSolverKernels(std::string shape) {
+    const std::vector<SolverKernels>& table = solverKernelTable();
+    for (auto it = table.begin(); it != table.end(); it++) {
+      if (it->shape == shape) return &*it;
+    }
+    return NULL;
+  }
+}
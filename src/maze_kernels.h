@@ -0,0 +1,244 @@
+#pragma once
+
+#include "maze_rows.h"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace mazeUtils {
+  class BitGridSolver;
+  class MazeNetwork;
+
+  enum Connectivity {
+    fourConnected = 4,  // north, south, east and west
+    eightConnected = 8  // diagonals too
+  };
+
+  // Compile-time description of a maze's look: square cells CellWidth
+  // pixels across, separated by walls (and an outer border) WallWidth pixels
+  // thick, and which moves are allowed between open pixels. Every kernel is
+  // specialised per shape, so the inner loops carry no runtime branches on
+  // any of these.
+  template <Connectivity C, unsigned int CellWidth, unsigned int WallWidth>
+  struct MazeShape {
+    static_assert(CellWidth >= 1 && WallWidth >= 1, "Cells and walls must be at least one pixel");
+    // A one pixel wall corner touches all four cells around it diagonally,
+    // so diagonal passages need room to pass through it.
+    static_assert(C == fourConnected || WallWidth >= 2, "Eight-connected mazes need walls at least two pixels thick");
+
+    static const Connectivity connectivity = C;
+    static const unsigned int cellWidth = CellWidth;
+    static const unsigned int wallWidth = WallWidth;
+    static const unsigned int pitch = CellWidth + WallWidth;
+
+    // Name used to pick the shape on the command line, e.g. "4:1:1"
+    static std::string name() {
+      return std::to_string(C) + ":" + std::to_string(CellWidth) + ":" + std::to_string(WallWidth);
+    }
+
+    // Pixels across a maze that is cells cells across
+    static std::size_t pixelsFor(std::size_t cells) {
+      return cells * pitch + WallWidth;
+    }
+
+    // Whole cells that fit in pixels pixels
+    static std::size_t cellsFor(std::size_t pixels) {
+      return pixels < WallWidth ? 0 : (pixels - WallWidth) / pitch;
+    }
+
+    // First pixel of cell
+    static std::size_t cellStart(std::size_t cell) {
+      return WallWidth + cell * pitch;
+    }
+
+    // Whether a maze of width x height pixels is made of whole cells
+    static bool fits(std::size_t width, std::size_t height) {
+      return pixelsFor(cellsFor(width)) == width && pixelsFor(cellsFor(height)) == height;
+    }
+
+    // The pixel that lattice coordinate l stands for, out of size lattice
+    // coordinates (see LatticeReader): the first pixel of its wall or cell,
+    // except that the far border stands for the maze's last pixel so that
+    // routes reach the exit row.
+    static std::size_t latticeToPixel(std::size_t l, std::size_t size) {
+      const std::size_t first = (l / 2) * pitch + (l % 2) * WallWidth;
+      return (l % 2 == 0 && l + 1 == size) ? first + WallWidth - 1 : first;
+    }
+  };
+
+  // Definitions, for when the constants are bound to references
+  template <Connectivity C, unsigned int CellWidth, unsigned int WallWidth>
+  const Connectivity MazeShape<C, CellWidth, WallWidth>::connectivity;
+  template <Connectivity C, unsigned int CellWidth, unsigned int WallWidth>
+  const unsigned int MazeShape<C, CellWidth, WallWidth>::cellWidth;
+  template <Connectivity C, unsigned int CellWidth, unsigned int WallWidth>
+  const unsigned int MazeShape<C, CellWidth, WallWidth>::wallWidth;
+  template <Connectivity C, unsigned int CellWidth, unsigned int WallWidth>
+  const unsigned int MazeShape<C, CellWidth, WallWidth>::pitch;
+
+  // The shape mazes had before shapes could be picked
+  typedef MazeShape<fourConnected, 1, 1> ClassicShape;
+
+  // Calls visitor with a default-constructed MazeShape for every shape the
+  // kernels are compiled for. Adding a shape here makes it available to
+  // both mazebuilder and mazesolver.
+  template <class Visitor>
+  void forEachShape(Visitor visitor) {
+    visitor(ClassicShape());
+    visitor(MazeShape<fourConnected, 2, 1>());
+    visitor(MazeShape<fourConnected, 3, 2>());
+    visitor(MazeShape<eightConnected, 2, 2>());
+    visitor(MazeShape<eightConnected, 3, 2>());
+  }
+
+  // Reads a maze image of any Shape as the classic one pixel lattice: odd
+  // coordinates are cells, even ones the walls between them and the wall
+  // corners. Each lattice row samples the first pixel row of its band of
+  // WallWidth (even) or CellWidth (odd) pixel rows, and each position the
+  // first pixel of its wall or cell. Eight-connected diagonals can't be
+  // drawn on the lattice, so their wall corners are left closed and the
+  // staircases through them are reported separately.
+  template <class Shape>
+  class LatticeReader {
+    public:
+      LatticeReader(IRowSource& pixels)
+      : pixels(pixels),
+      cellsAcross(Shape::cellsFor(pixels.width())),
+      cellsDown(Shape::cellsFor(pixels.height())) {}
+
+      std::size_t width() {
+        return 2 * cellsAcross + 1;
+      }
+
+      std::size_t height() {
+        return 2 * cellsDown + 1;
+      }
+
+      // Why the image can't be read as a Shape maze, or empty if it can
+      std::string getError() {
+        if (Shape::fits(pixels.width(), pixels.height())) return "";
+        return "A " + std::to_string(pixels.width()) + " x " + std::to_string(pixels.height())
+          + " image isn't made of whole " + Shape::name() + " cells";
+      }
+
+      // Fills row with the next lattice row. For an eight-connected Shape,
+      // southEast and southWest get the wall corners of a wall row (even
+      // positions) with a staircase leaving them in that direction. Returns
+      // false once every row has been read, or if the pixels run out.
+      bool next(PackedRow& row, PackedRow& southEast, PackedRow& southWest) {
+        if (nextY >= height()) return false;
+        const bool wallRow = nextY % 2 == 0;
+        const unsigned int band = wallRow ? Shape::wallWidth : Shape::cellWidth;
+        if (!pixels.nextRow(pixelRow)) return false;
+        for (unsigned int skip = 1; skip < band; ++skip) {
+          if (!pixels.nextRow(skipped)) return false;
+        }
+
+        const std::size_t words = wordsForWidth(width());
+        row.assign(words, 0);
+        for (std::size_t cell = 0; cell <= cellsAcross; ++cell) {
+          const std::size_t wallX = cell * Shape::pitch;
+          // A south-east staircase starts in the first column of its
+          // corner, and a south-west one in the last
+          const bool corner = Shape::connectivity == eightConnected && wallRow;
+          if (!corner && isOpen(pixelRow, wallX)) setOpen(row, 2 * cell);
+          if (cell < cellsAcross && isOpen(pixelRow, wallX + Shape::wallWidth)) setOpen(row, 2 * cell + 1);
+        }
+        if (Shape::connectivity == eightConnected) {
+          southEast.assign(words, 0);
+          southWest.assign(words, 0);
+          for (std::size_t cell = 1; wallRow && cell < cellsAcross; ++cell) {
+            const std::size_t wallX = cell * Shape::pitch;
+            if (isOpen(pixelRow, wallX)) setOpen(southEast, 2 * cell);
+            if (isOpen(pixelRow, wallX + Shape::wallWidth - 1)) setOpen(southWest, 2 * cell);
+          }
+        }
+        nextY++;
+        return true;
+      }
+    private:
+      IRowSource& pixels;
+      const std::size_t cellsAcross;
+      const std::size_t cellsDown;
+      std::size_t nextY = 0;
+      PackedRow pixelRow;
+      PackedRow skipped;
+  };
+
+  // The classic shape already is the lattice, so its rows pass straight
+  // through, whatever their size
+  template <>
+  class LatticeReader<ClassicShape> {
+    public:
+      LatticeReader(IRowSource& pixels) : pixels(pixels) {}
+
+      std::size_t width() {
+        return pixels.width();
+      }
+
+      std::size_t height() {
+        return pixels.height();
+      }
+
+      std::string getError() {
+        return "";
+      }
+
+      bool next(PackedRow& row, PackedRow&, PackedRow&) {
+        return pixels.nextRow(row);
+      }
+    private:
+      IRowSource& pixels;
+  };
+
+  // The lattice of a four-connected Shape maze as rows of its own, for the
+  // solvers that only need its open positions.
+  template <class Shape>
+  class LatticeRowSource : public IRowSource {
+    public:
+      LatticeRowSource(IRowSource& pixels)
+      : pixels(pixels),
+      lattice(pixels),
+      error(lattice.getError()) {}
+
+      virtual std::size_t width() {
+        return lattice.width();
+      }
+
+      virtual std::size_t height() {
+        return lattice.height();
+      }
+
+      virtual bool nextRow(PackedRow& row) {
+        return error.empty() && lattice.next(row, unused, unused);
+      }
+
+      virtual std::string getError() {
+        return error.empty() ? pixels.getError() : error;
+      }
+    private:
+      IRowSource& pixels;
+      LatticeReader<Shape> lattice;
+      const std::string error;
+      PackedRow unused;
+  };
+
+  // One row of mazesolver's dispatch table: the kernels specialised for a shape
+  struct SolverKernels {
+    std::string shape;
+    Connectivity connectivity;
+    // Whether an image of width x height pixels is made of whole cells.
+    // The kernels fail on images that aren't.
+    bool (*fits)(std::size_t width, std::size_t height);
+    // Reads rows into solver, sampling them down to the lattice if needed
+    int (*loadGrid)(BitGridSolver& solver, IRowSource& rows);
+    // Lengths and paths come out in pixels, whatever the shape
+    bool (*solveGrid)(BitGridSolver& solver);
+    int (*parseGraph)(MazeNetwork& network, IRowSource& rows);
+  };
+
+  const std::vector<SolverKernels>& solverKernelTable();
+  // Returns NULL if there's no such shape
+  const SolverKernels* findSolverKernels(std::string shape);
+}
@@ -0,0 +1,116 @@
+#include "maze_memory.h"
+
+#include <iomanip>
+#include <sstream>
+
+namespace mazeUtils {
+  void* HeapAllocator::allocate(std::size_t bytes) {
+    return ::operator new(bytes);
+  }
+
+  void HeapAllocator::deallocate(void* pointer, std::size_t) {
+    ::operator delete(pointer);
+  }
+
+  MemoryBudgetExceeded::MemoryBudgetExceeded(std::size_t requested, std::size_t inUse, std::size_t budget) {
+    std::ostringstream oss;
+    oss << "Memory budget of " << formatMegabytes(budget) << " exceeded ("
+        << requested << " bytes requested with " << formatMegabytes(inUse) << " in use)";
+    message = oss.str();
+  }
+
+  const char* MemoryBudgetExceeded::what() const noexcept {
+    return message.c_str();
+  }
+
+  MemoryTracker::MemoryTracker(IAllocator* upstream)
+  : upstream(upstream),
+  budget(0),
+  current(0),
+  peak(0),
+  allocations(0) {
+    if (this->upstream == NULL) {
+      static HeapAllocator heap;
+      this->upstream = &heap;
+    }
+  }
+
+  void* MemoryTracker::allocate(std::size_t bytes) {
+    // Claim the bytes first, so concurrent allocations can't both slip
+    // under the budget
+    std::size_t inUse = current.fetch_add(bytes) + bytes;
+    std::size_t limit = budget.load();
+    if (limit != 0 && inUse > limit) {
+      current.fetch_sub(bytes);
+      throw MemoryBudgetExceeded(bytes, inUse - bytes, limit);
+    }
+
+    void* pointer;
+    try {
+      pointer = upstream->allocate(bytes);
+    } catch (...) {
+      current.fetch_sub(bytes);
+      throw;
+    }
+    allocations++;
+
+    std::size_t seen = peak.load();
+    while (inUse > seen && !peak.compare_exchange_weak(seen, inUse)) {}
+    return pointer;
+  }
+
+  void MemoryTracker::deallocate(void* pointer, std::size_t bytes) {
+    if (pointer == NULL) return;
+    upstream->deallocate(pointer, bytes);
+    current.fetch_sub(bytes);
+  }
+
+  void MemoryTracker::setUpstream(IAllocator* upstream) {
+    this->upstream = upstream;
+  }
+
+  void MemoryTracker::setBudget(std::size_t bytes) {
+    budget = bytes;
+  }
+
+  std::size_t MemoryTracker::getBudget() {
+    return budget;
+  }
+
+  std::size_t MemoryTracker::getCurrentBytes() {
+    return current;
+  }
+
+  std::size_t MemoryTracker::getPeakBytes() {
+    return peak;
+  }
+
+  unsigned long long MemoryTracker::getAllocationCount() {
+    return allocations;
+  }
+
+  void MemoryTracker::resetStats() {
+    peak = current.load();
+    allocations = 0;
+  }
+
+  std::string MemoryTracker::summary() {
+    std::ostringstream oss;
+    oss << "peak " << formatMegabytes(getPeakBytes()) << " in " << getAllocationCount() << " allocations";
+    if (getBudget() != 0) {
+      oss << " (budget " << formatMegabytes(getBudget()) << ")";
+    }
+    return oss.str();
+  }
+
+  MemoryTracker& memoryTracker() {
+    static MemoryTracker tracker;
+    return tracker;
+  }
+
+  std::string formatMegabytes(std::size_t bytes) {
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(1) << bytes / (1024.0 * 1024.0) << " MB";
+    return oss.str();
+  }
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <string>
+#include <vector>
+
+namespace mazeUtils {
+  // Where tracked memory ultimately comes from. MemoryTracker forwards every
+  // request to one of these, so a host can plug in its own heap.
+  class IAllocator {
+    public:
+      virtual ~IAllocator() {}
+
+      virtual void* allocate(std::size_t bytes) = 0;
+      virtual void deallocate(void* pointer, std::size_t bytes) = 0;
+  };
+
+  // The global operator new and delete
+  class HeapAllocator : public IAllocator {
+    public:
+      virtual void* allocate(std::size_t bytes);
+      virtual void deallocate(void* pointer, std::size_t bytes);
+  };
+
+  // Thrown when an allocation would take a MemoryTracker over its budget
+  class MemoryBudgetExceeded : public std::bad_alloc {
+    public:
+      MemoryBudgetExceeded(std::size_t requested, std::size_t inUse, std::size_t budget);
+
+      virtual const char* what() const noexcept;
+    private:
+      std::string message;
+  };
+
+  // Counts the bytes allocated through it and remembers the peak. With a
+  // budget set, any allocation that would take it past the budget throws
+  // MemoryBudgetExceeded instead. Safe to use from several threads.
+  class MemoryTracker : public IAllocator {
+    public:
+      MemoryTracker(IAllocator* upstream = NULL);
+
+      virtual void* allocate(std::size_t bytes);
+      virtual void deallocate(void* pointer, std::size_t bytes);
+
+      // Only swap the upstream allocator while nothing is allocated from it
+      void setUpstream(IAllocator* upstream);
+      // 0 means no budget
+      void setBudget(std::size_t bytes);
+      std::size_t getBudget();
+      std::size_t getCurrentBytes();
+      std::size_t getPeakBytes();
+      unsigned long long getAllocationCount();
+      // Starts a new measurement: the peak drops to what's in use now and
+      // the allocation count to zero.
+      void resetStats();
+      // e.g. "peak 12.5 MB in 40213 allocations (budget 64.0 MB)"
+      std::string summary();
+    private:
+      IAllocator* upstream;
+      std::atomic<std::size_t> budget;
+      std::atomic<std::size_t> current;
+      std::atomic<std::size_t> peak;
+      std::atomic<unsigned long long> allocations;
+  };
+
+  // The tracker every maze structure allocates from
+  MemoryTracker& memoryTracker();
+
+  // Formats a byte count as megabytes, e.g. "12.5 MB"
+  std::string formatMegabytes(std::size_t bytes);
+
+  // Standard allocator that draws from memoryTracker(), for containers that
+  // grow with the size of the maze.
+  template <class T>
+  class TrackingAllocator {
+    public:
+      typedef T value_type;
+
+      TrackingAllocator() {}
+      template <class U>
+      TrackingAllocator(const TrackingAllocator<U>&) {}
+
+      T* allocate(std::size_t count) {
+        return static_cast<T*>(memoryTracker().allocate(count * sizeof(T)));
+      }
+
+      void deallocate(T* pointer, std::size_t count) {
+        memoryTracker().deallocate(pointer, count * sizeof(T));
+      }
+  };
+
+  template <class T, class U>
+  bool operator==(const TrackingAllocator<T>&, const TrackingAllocator<U>&) {
+    return true;
+  }
+
+  template <class T, class U>
+  bool operator!=(const TrackingAllocator<T>&, const TrackingAllocator<U>&) {
+    return false;
+  }
+
+  template <class T>
+  using TrackedVector = std::vector<T, TrackingAllocator<T>>;
+}
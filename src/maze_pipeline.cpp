@@ -0,0 +1,259 @@
+#include "maze_pipeline.h"
+
+#include "maze_bitsolver.h"
+#include "maze_memory.h"
+#include "maze_utils.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+namespace mazeUtils {
+  namespace {
+    typedef std::chrono::steady_clock Clock;
+
+    uint64_t nanosecondsSince(Clock::time_point t1) {
+      return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - t1).count();
+    }
+  }
+
+  // Shares the memory budget out between the mazes in flight. Each maze
+  // reserves its estimate before it's parsed and hands it back once it's
+  // solved, so the mazes parsed and queued at once can't add up to more
+  // than the budget between them.
+  class MazePipeline::BudgetPool {
+    public:
+      // capacity 0 means there's no budget
+      BudgetPool(std::size_t capacity) : capacity(capacity) {}
+
+      // Waits until bytes fits alongside the other reservations. Returns
+      // false straight away if it never would.
+      bool reserve(std::size_t bytes) {
+        if (capacity == 0) return true;
+        std::unique_lock<std::mutex> lock(mutex);
+        if (bytes > capacity) return false;
+        released.wait(lock, [&] { return reserved + bytes <= capacity; });
+        reserved += bytes;
+        return true;
+      }
+
+      void release(std::size_t bytes) {
+        if (capacity == 0) return;
+        std::lock_guard<std::mutex> lock(mutex);
+        reserved -= bytes;
+        released.notify_all();
+      }
+
+      std::size_t getCapacity() {
+        return this->capacity;
+      }
+    private:
+      const std::size_t capacity;
+      std::size_t reserved = 0;
+      std::mutex mutex;
+      std::condition_variable released;
+  };
+
+  QueueByteSource::QueueByteSource(std::shared_ptr<BlockQueue> blocks, uint64_t& waitNanoseconds)
+  : blocks(blocks),
+  waitNanoseconds(waitNanoseconds) {}
+
+  std::size_t QueueByteSource::read(uint8_t* buffer, std::size_t size) {
+    while (position == block.size()) {
+      auto t1 = Clock::now();
+      bool more = blocks->pop(block);
+      waitNanoseconds += nanosecondsSince(t1);
+      position = 0;
+      if (!more) {
+        block.clear();
+        return 0;
+      }
+    }
+    std::size_t count = std::min(size, block.size() - position);
+    std::memcpy(buffer, block.data() + position, count);
+    position += count;
+    return count;
+  }
+
+  // A maze that has been parsed and is waiting for the solver
+  struct MazePipeline::ParsedMaze {
+    ParsedMaze(BudgetPool& pool) : pool(pool) {}
+    // Hands the reservation back once the maze's memory has been freed
+    ~ParsedMaze() {
+      graph.reset();
+      grid.reset();
+      pool.release(reservedBytes);
+    }
+
+    std::size_t index;
+    BudgetPool& pool;
+    std::size_t reservedBytes = 0;
+    std::unique_ptr<MazeNetwork> graph;
+    std::unique_ptr<BitGridSolver> grid;
+  };
+
+  MazePipeline::MazePipeline(Options options)
+  : options(options) {
+    this->options.parseWorkers = std::max(1u, options.parseWorkers);
+    this->options.queueBlocks = std::max<std::size_t>(1, options.queueBlocks);
+    this->options.blockSize = std::max<std::size_t>(1, options.blockSize);
+  }
+
+  std::vector<MazePipeline::Result> MazePipeline::run(const std::vector<std::string>& filePaths) {
+    const std::size_t count = filePaths.size();
+    std::vector<Result> results(count);
+    for (std::size_t i = 0; i < count; ++i) results[i].filePath = filePaths[i];
+
+    std::vector<std::shared_ptr<BlockQueue>> blockQueues;
+    for (std::size_t i = 0; i < count; ++i) {
+      blockQueues.push_back(std::make_shared<BlockQueue>(options.queueBlocks));
+    }
+    // Set by the reader before it closes the file's queue
+    std::unique_ptr<std::atomic<bool>[]> readFailed(new std::atomic<bool>[count]);
+    for (std::size_t i = 0; i < count; ++i) readFailed[i] = false;
+    BoundedQueue<std::unique_ptr<ParsedMaze>> parsed(options.parseWorkers);
+    // Whatever is already allocated isn't ours to hand out
+    const std::size_t budget = memoryTracker().getBudget();
+    const std::size_t inUse = memoryTracker().getCurrentBytes();
+    BudgetPool pool(budget == 0 ? 0 : (budget > inUse ? budget - inUse : 1));
+
+    std::unique_ptr<IBlockReader> reader = createBlockReader(options.useIoUring);
+    readerName = reader->name();
+    std::atomic<std::size_t> nextToParse(0);
+    std::atomic<uint64_t> parseBusyNanoseconds(0);
+    uint64_t solveBusyNanoseconds = 0;
+
+    auto t1 = Clock::now();
+
+    // Read stage: one file after another, as fast as the parsers drain them
+    std::thread readThread([&]() {
+      for (std::size_t i = 0; i < count; ++i) {
+        int result = reader->readFile(filePaths[i], options.blockSize,
+          [&](std::vector<uint8_t>& block) { return blockQueues[i]->push(std::move(block)); });
+        if (result != 0) readFailed[i] = 1;
+        blockQueues[i]->close();
+      }
+    });
+
+    // Parse stage: each worker takes the next file and decodes it as its
+    // blocks arrive
+    auto parseWorker = [&]() {
+      std::size_t i;
+      while ((i = nextToParse++) < count) {
+        auto t2 = Clock::now();
+        std::unique_ptr<ParsedMaze> maze(new ParsedMaze(pool));
+        maze->index = i;
+        uint64_t waited = 0;
+        try {
+          std::unique_ptr<IRowSource> rows = decodeRowSource(
+            std::unique_ptr<IByteSource>(new QueueByteSource(blockQueues[i], waited)));
+          const std::size_t estimate = rows ? estimateBytes(rows->width(), rows->height()) + rows->bufferBytes() : 0;
+          auto t3 = Clock::now();
+          const bool reserved = rows && pool.reserve(estimate);
+          // Waiting for other mazes to finish isn't parse work
+          waited += nanosecondsSince(t3);
+          if (!rows) {
+            results[i].error = "Unsupported or unreadable maze image";
+          }
+          else if (!reserved) {
+            // Refuse before parsing anything, rather than part way through
+            results[i].error = "Needs about " + formatMegabytes(estimate)
+              + ", over the " + formatMegabytes(pool.getCapacity()) + " left in the memory budget";
+          }
+          else if (options.engine == "bitgrid") {
+            maze->reservedBytes = estimate;
+            maze->grid.reset(new BitGridSolver());
+            if (maze->grid->load(*rows) != 0) results[i].error = "Maze image ended early";
+          }
+          else {
+            maze->reservedBytes = estimate;
+            maze->graph.reset(new MazeNetwork());
+            if (maze->graph->parse(*rows) != 0) results[i].error = "No entrance or exit found";
+          }
+          // A truncated or corrupt image says why it stopped short
+          if (rows && !rows->getError().empty()) results[i].error = rows->getError();
+        } catch (std::exception const& e) {
+          results[i].error = e.what();
+        }
+        // A read error shows up to the decoder as a truncated file, so
+        // report the real cause
+        if (readFailed[i]) results[i].error = "Failed to read file";
+        // Stop the reader from waiting on a file we've given up on
+        blockQueues[i]->close();
+        uint64_t elapsed = nanosecondsSince(t2);
+        parseBusyNanoseconds += elapsed > waited ? elapsed - waited : 0;
+
+        if (results[i].error.empty()) parsed.push(std::move(maze));
+      }
+    };
+    std::vector<std::thread> parseThreads;
+    for (unsigned int w = 0; w < options.parseWorkers; ++w) {
+      parseThreads.push_back(std::thread(parseWorker));
+    }
+
+    // Solve stage: mazes are solved in whatever order they finish parsing
+    std::thread solveThread([&]() {
+      std::unique_ptr<ParsedMaze> maze;
+      while (parsed.pop(maze)) {
+        auto t4 = Clock::now();
+        Result& result = results[maze->index];
+        try {
+          if (maze->graph) {
+            result.solved = !maze->graph->solve().empty();
+            result.nodes = maze->graph->getNodeCount();
+            result.solutionLength = maze->graph->getSolutionLength();
+          }
+          else {
+            result.solved = maze->grid->solve();
+            if (result.solved) result.solutionLength = maze->grid->getPath().size() - 1;
+          }
+          if (!result.solved) result.error = "No solution found";
+        } catch (std::exception const& e) {
+          // e.g. the memory budget ran out part way through the search
+          result.solved = false;
+          result.error = e.what();
+        }
+        // Free the graph before timing stops, as it's part of the work
+        maze.reset();
+        solveBusyNanoseconds += nanosecondsSince(t4);
+      }
+    });
+
+    readThread.join();
+    for (auto it = parseThreads.begin(); it != parseThreads.end(); it++) it->join();
+    parsed.close();
+    solveThread.join();
+    wallSeconds = nanosecondsSince(t1) / 1000000000.0;
+
+    auto report = [this](std::string name, unsigned int workers, double busy) {
+      double utilization = wallSeconds > 0 ? busy / (wallSeconds * workers) : 0;
+      return StageReport{name, workers, busy, utilization};
+    };
+    stages.clear();
+    stages.push_back(report("read", 1, reader->getIoSeconds()));
+    stages.push_back(report("parse", options.parseWorkers, parseBusyNanoseconds / 1000000000.0));
+    stages.push_back(report("solve", 1, solveBusyNanoseconds / 1000000000.0));
+    return results;
+  }
+
+  std::size_t MazePipeline::estimateBytes(std::size_t width, std::size_t height) {
+    if (options.engine == "bitgrid") return BitGridSolver::estimateBytes(width, height);
+    return MazeNetwork::estimateBytes(width, height);
+  }
+
+  std::vector<MazePipeline::StageReport> MazePipeline::getStageReports() {
+    return this->stages;
+  }
+
+  double MazePipeline::getWallSeconds() {
+    return this->wallSeconds;
+  }
+
+  std::string MazePipeline::getReaderName() {
+    return this->readerName;
+  }
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include "maze_format.h"
+#include "maze_io.h"
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace mazeUtils {
+  // A fixed-capacity queue between two pipeline stages. push blocks while
+  // the queue is full and pop blocks while it is empty.
+  template <class T>
+  class BoundedQueue {
+    public:
+      BoundedQueue(std::size_t capacity) : capacity(capacity) {}
+
+      // Returns false (dropping item) if the queue has been closed
+      bool push(T item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notFull.wait(lock, [this] { return closed || items.size() < capacity; });
+        if (closed) return false;
+        items.push_back(std::move(item));
+        notEmpty.notify_one();
+        return true;
+      }
+
+      // Returns false once the queue is closed and empty
+      bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notEmpty.wait(lock, [this] { return closed || !items.empty(); });
+        if (items.empty()) return false;
+        item = std::move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+      }
+
+      // No more items will be pushed. Anything already queued can still be popped.
+      void close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        notFull.notify_all();
+        notEmpty.notify_all();
+      }
+    private:
+      std::size_t capacity;
+      std::deque<T> items;
+      bool closed = false;
+      std::mutex mutex;
+      std::condition_variable notFull;
+      std::condition_variable notEmpty;
+  };
+
+  typedef BoundedQueue<std::vector<uint8_t>> BlockQueue;
+
+  // Lets a decoder consume blocks from the reader thread as they arrive.
+  // Time spent waiting for the next block is added to waitNanoseconds.
+  class QueueByteSource : public IByteSource {
+    public:
+      QueueByteSource(std::shared_ptr<BlockQueue> blocks, uint64_t& waitNanoseconds);
+
+      virtual std::size_t read(uint8_t* buffer, std::size_t size);
+    private:
+      std::shared_ptr<BlockQueue> blocks;
+      std::vector<uint8_t> block;
+      std::size_t position = 0;
+      uint64_t& waitNanoseconds;
+  };
+
+  // Reads, parses and solves a batch of mazes with every stage running at
+  // once: a reader thread prefetches blocks of each file (io_uring, or
+  // pread as a fallback), parse workers decode them into graphs as the
+  // blocks arrive, and a solver thread works on maze N while later mazes
+  // are still being read and parsed. Under a memory budget each maze
+  // reserves what it's expected to need before it's parsed, and waits until
+  // enough earlier mazes have been solved to make room.
+  class MazePipeline {
+    public:
+      struct Options {
+        // "graph" (MazeNetwork) or "bitgrid" (BitGridSolver)
+        std::string engine = "graph";
+        std::size_t blockSize = 1 << 20;
+        // Blocks each file may have queued ahead of its parser
+        std::size_t queueBlocks = 16;
+        unsigned int parseWorkers = 1;
+        bool useIoUring = true;
+      };
+
+      struct Result {
+        std::string filePath;
+        bool solved = false;
+        std::size_t nodes = 0;
+        unsigned long int solutionLength = 0;
+        std::string error;
+      };
+
+      struct StageReport {
+        std::string name;
+        unsigned int workers;
+        double busySeconds;
+        // Fraction of the run's wall time that the stage's workers were busy
+        double utilization;
+      };
+
+      MazePipeline(Options options);
+
+      // Results are in the same order as filePaths
+      std::vector<Result> run(const std::vector<std::string>& filePaths);
+      std::vector<StageReport> getStageReports();
+      double getWallSeconds();
+      std::string getReaderName();
+    private:
+      class BudgetPool;
+      struct ParsedMaze;
+
+      Options options;
+      std::string readerName;
+      double wallSeconds = 0;
+      std::vector<StageReport> stages;
+
+      // What the chosen engine is expected to need for one maze
+      std::size_t estimateBytes(std::size_t width, std::size_t height);
+  };
+}
@@ -0,0 +1,250 @@
+#include "maze_png.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+namespace mazeUtils {
+  namespace {
+    const uint8_t PNG_SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+
+    uint32_t readBigEndian32(const uint8_t* bytes) {
+      return ((uint32_t)bytes[0] << 24) | (bytes[1] << 16) | (bytes[2] << 8) | bytes[3];
+    }
+
+    // Reads the length and type of the next chunk
+    bool readChunkHeader(ByteReader& reader, uint32_t& length, char type[4]) {
+      uint8_t header[8];
+      if (!reader.readExact(header, 8)) return false;
+      length = readBigEndian32(header);
+      std::memcpy(type, header + 4, 4);
+      return true;
+    }
+
+    uint8_t paeth(uint8_t a, uint8_t b, uint8_t c) {
+      int p = (int)a + b - c;
+      int pa = std::abs(p - a);
+      int pb = std::abs(p - b);
+      int pc = std::abs(p - c);
+      if (pa <= pb && pa <= pc) return a;
+      if (pb <= pc) return b;
+      return c;
+    }
+  }
+
+  void PngRowSource::ImageDataSource::start(std::size_t chunkLength) {
+    remaining = chunkLength;
+  }
+
+  std::size_t PngRowSource::ImageDataSource::read(uint8_t* buffer, std::size_t size) {
+    // Move on to the next chunk, which must also be IDAT to continue the stream
+    while (remaining == 0) {
+      uint32_t length;
+      char type[4];
+      if (done || !reader.skip(4) || !readChunkHeader(reader, length, type)
+          || std::memcmp(type, "IDAT", 4) != 0) {
+        done = true;
+        return 0;
+      }
+      remaining = length;
+    }
+    std::size_t count = reader.read(buffer, std::min(size, remaining));
+    remaining -= count;
+    return count;
+  }
+
+  PngRowSource::PngRowSource(std::unique_ptr<IByteSource> source)
+  : source(std::move(source)),
+  reader(*this->source),
+  imageData(reader)
+  {
+    open = readHeader();
+  }
+
+  bool PngRowSource::isSignature(const uint8_t* bytes) {
+    return std::memcmp(bytes, PNG_SIGNATURE, 8) == 0;
+  }
+
+  bool PngRowSource::isOpen() {
+    return this->open;
+  }
+
+  std::size_t PngRowSource::width() {
+    return this->imageWidth;
+  }
+
+  std::size_t PngRowSource::height() {
+    return this->imageHeight;
+  }
+
+  bool PngRowSource::readHeader() {
+    uint8_t signature[8];
+    if (!reader.readExact(signature, 8) || !isSignature(signature)) return false;
+
+    bool seenHeader = false;
+    uint32_t length = 0;
+    char type[4] = {0};
+    while (readChunkHeader(reader, length, type)) {
+      if (std::memcmp(type, "IHDR", 4) == 0) {
+        uint8_t header[13];
+        if (length != 13 || !reader.readExact(header, 13)) return false;
+        imageWidth = readBigEndian32(header);
+        imageHeight = readBigEndian32(header + 4);
+        bitDepth = header[8];
+        colorType = (ColorType)header[9];
+        if (header[10] != 0 || header[11] != 0) return false;
+        if (header[12] != 0) {
+          std::cout << "Error - Interlaced PNG images are not supported" << std::endl;
+          return false;
+        }
+        seenHeader = true;
+      }
+      else if (std::memcmp(type, "PLTE", 4) == 0) {
+        // At most 256 entries of three bytes
+        if (length > 768) return false;
+        std::vector<uint8_t> palette(length);
+        if (!reader.readExact(palette.data(), length)) return false;
+        for (std::size_t i = 0; i + 2 < length; i += 3) {
+          whitePalette.push_back(palette[i] == 255 && palette[i + 1] == 255 && palette[i + 2] == 255);
+        }
+      }
+      else if (std::memcmp(type, "IDAT", 4) == 0) {
+        break;
+      }
+      else if (std::memcmp(type, "IEND", 4) == 0) {
+        return false;
+      }
+      else if (!reader.skip(length)) {
+        return false;
+      }
+      // Skip the CRC
+      if (!reader.skip(4)) return false;
+    }
+    if (!seenHeader || std::memcmp(type, "IDAT", 4) != 0) return false;
+
+    unsigned int channels;
+    switch (colorType) {
+      case grayscale: channels = 1; break;
+      case truecolor: channels = 3; break;
+      case indexed: channels = 1; break;
+      case grayscaleAlpha: channels = 2; break;
+      case truecolorAlpha: channels = 4; break;
+      default:
+        std::cout << "Error - Unknown PNG colour type: " << (int)colorType << std::endl;
+        return false;
+    }
+    bool validDepth = (bitDepth == 8 || bitDepth == 16)
+      || ((colorType == grayscale || colorType == indexed) && (bitDepth == 1 || bitDepth == 2 || bitDepth == 4));
+    if (!validDepth || (colorType == indexed && bitDepth == 16)) {
+      std::cout << "Error - Unsupported PNG bit depth: " << bitDepth << std::endl;
+      return false;
+    }
+
+    const std::size_t bitsPerPixel = channels * bitDepth;
+    bytesPerPixel = bitsPerPixel < 8 ? 1 : bitsPerPixel / 8;
+    rowBytes = (imageWidth * bitsPerPixel + 7) / 8;
+
+    imageData.start(length);
+    try {
+      inflater.reset(new Inflater(imageData, true));
+    } catch (std::runtime_error const& e) {
+      // As in nextRow(), a corrupt stream is reported rather than thrown
+      error = e.what();
+      std::cout << "Error - Corrupt PNG image data: " << error << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+  bool PngRowSource::nextRow(PackedRow& row) {
+    if (!open || nextY >= imageHeight) return false;
+    if (nextY == 0) {
+      previous.assign(rowBytes, 0);
+      current.assign(rowBytes, 0);
+    }
+
+    uint8_t filter;
+    try {
+      if (!inflater->readExact(&filter, 1) || !inflater->readExact(current.data(), current.size())) {
+        error = "PNG image data ended after " + std::to_string(nextY) + " rows";
+        return false;
+      }
+    } catch (std::runtime_error const& e) {
+      // The Inflater gives up on a corrupt deflate stream by throwing
+      error = e.what();
+      return false;
+    }
+    if (!unfilter(filter)) return false;
+
+    row.assign(wordsForWidth(imageWidth), 0);
+    for (std::size_t x = 0; x < imageWidth; ++x) {
+      if (isWhite(x)) setOpen(row, x);
+    }
+    previous.swap(current);
+    nextY++;
+    return true;
+  }
+
+  std::string PngRowSource::getError() {
+    return this->error;
+  }
+
+  bool PngRowSource::unfilter(uint8_t filter) {
+    const std::size_t size = current.size();
+    const std::size_t bpp = bytesPerPixel;
+    switch (filter) {
+      case 0:
+        break;
+      case 1:
+        for (std::size_t i = bpp; i < size; ++i) current[i] += current[i - bpp];
+        break;
+      case 2:
+        for (std::size_t i = 0; i < size; ++i) current[i] += previous[i];
+        break;
+      case 3:
+        for (std::size_t i = 0; i < size; ++i) {
+          unsigned int left = i >= bpp ? current[i - bpp] : 0;
+          current[i] += (left + previous[i]) / 2;
+        }
+        break;
+      case 4:
+        for (std::size_t i = 0; i < size; ++i) {
+          uint8_t left = i >= bpp ? current[i - bpp] : 0;
+          uint8_t upLeft = i >= bpp ? previous[i - bpp] : 0;
+          current[i] += paeth(left, previous[i], upLeft);
+        }
+        break;
+      default:
+        error = "Unknown PNG filter type " + std::to_string(filter) + " in row " + std::to_string(nextY);
+        return false;
+    }
+    return true;
+  }
+
+  bool PngRowSource::isWhite(std::size_t x) {
+    if (bitDepth < 8) {
+      // Samples are packed most significant bit first
+      const std::size_t bit = x * bitDepth;
+      const unsigned int maximum = (1u << bitDepth) - 1;
+      unsigned int sample = (current[bit / 8] >> (8 - bitDepth - bit % 8)) & maximum;
+      if (colorType == indexed) {
+        return sample < whitePalette.size() && whitePalette[sample];
+      }
+      return sample == maximum;
+    }
+    if (colorType == indexed) {
+      unsigned int index = current[x];
+      return index < whitePalette.size() && whitePalette[index];
+    }
+
+    // Every byte of every colour channel must be 0xff
+    const std::size_t colorBytes = (colorType == truecolor || colorType == truecolorAlpha ? 3 : 1) * (bitDepth / 8);
+    const uint8_t* pixel = &current[x * bytesPerPixel];
+    for (std::size_t i = 0; i < colorBytes; ++i) {
+      if (pixel[i] != 0xff) return false;
+    }
+    return true;
+  }
+}
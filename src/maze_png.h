@@ -0,0 +1,77 @@
+#pragma once
+
+#include "maze_format.h"
+#include "maze_inflate.h"
+#include "maze_rows.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace mazeUtils {
+  // Streams rows out of a PNG image, decompressing with the bundled
+  // Inflater. Handles every non-interlaced colour type and bit depth; a
+  // pixel is open when all of its colour channels are at full intensity
+  // (alpha is ignored).
+  class PngRowSource : public IRowSource {
+    public:
+      PngRowSource(std::unique_ptr<IByteSource> source);
+
+      static bool isSignature(const uint8_t* bytes);
+
+      bool isOpen();
+      virtual std::size_t width();
+      virtual std::size_t height();
+      virtual bool nextRow(PackedRow& row);
+      virtual std::string getError();
+    private:
+      // Presents the contents of consecutive IDAT chunks as one stream
+      class ImageDataSource : public IByteSource {
+        public:
+          ImageDataSource(ByteReader& reader) : reader(reader) {}
+
+          void start(std::size_t chunkLength);
+          virtual std::size_t read(uint8_t* buffer, std::size_t size);
+        private:
+          ByteReader& reader;
+          std::size_t remaining = 0;
+          bool done = false;
+      };
+
+      enum ColorType {
+        grayscale = 0,
+        truecolor = 2,
+        indexed = 3,
+        grayscaleAlpha = 4,
+        truecolorAlpha = 6
+      };
+
+      std::unique_ptr<IByteSource> source;
+      ByteReader reader;
+      ImageDataSource imageData;
+      std::unique_ptr<Inflater> inflater;
+      bool open = false;
+      std::string error;
+
+      std::size_t imageWidth = 0;
+      std::size_t imageHeight = 0;
+      unsigned int bitDepth = 0;
+      ColorType colorType = grayscale;
+      // Whether each palette entry is white
+      std::vector<bool> whitePalette;
+      std::size_t nextY = 0;
+
+      std::size_t bytesPerPixel = 1;
+      std::size_t rowBytes = 0;
+      // The unfiltered row above and the one being read, sized on the
+      // first call to nextRow
+      TrackedVector<uint8_t> previous;
+      TrackedVector<uint8_t> current;
+
+      bool readHeader();
+      bool unfilter(uint8_t filter);
+      bool isWhite(std::size_t x);
+  };
+}
@@ -0,0 +1,92 @@
+#include "maze_rows.h"
+
+#include "maze_format.h"
+
+#include "bitmap_image.hpp"
+
+#include <iostream>
+
+namespace mazeUtils {
+  class BitmapRowSource::Impl {
+    public:
+      Impl(std::string filePath) : image(filePath) {}
+
+      bitmap_image image;
+      std::size_t nextY = 0;
+  };
+
+  BitmapRowSource::BitmapRowSource(std::string filePath)
+  : impl(new Impl(filePath)) {}
+
+  BitmapRowSource::~BitmapRowSource() {}
+
+  bool BitmapRowSource::isOpen() {
+    return !!impl->image;
+  }
+
+  std::size_t BitmapRowSource::width() {
+    return impl->image.width();
+  }
+
+  std::size_t BitmapRowSource::height() {
+    return impl->image.height();
+  }
+
+  bool BitmapRowSource::nextRow(PackedRow& row) {
+    const std::size_t y = impl->nextY;
+    if (y >= height()) return false;
+
+    const std::size_t w = width();
+    row.assign(wordsForWidth(w), 0);
+    rgb_t pixel;
+    for (std::size_t x = 0; x < w; ++x) {
+      impl->image.get_pixel(x, y, pixel);
+      if (pixel.red == 255 && pixel.green == 255 && pixel.blue == 255) {
+        setOpen(row, x);
+      }
+    }
+    impl->nextY++;
+    return true;
+  }
+
+  MemoryRowSource::MemoryRowSource(std::size_t width, std::vector<PackedRow> rows)
+  : rowWidth(width),
+  rows(std::move(rows)) {}
+
+  MemoryRowSource::MemoryRowSource(const std::vector<std::string>& picture)
+  : rowWidth(picture.empty() ? 0 : picture[0].size()) {
+    for (auto it = picture.begin(); it != picture.end(); it++) {
+      PackedRow row(wordsForWidth(rowWidth), 0);
+      for (std::size_t x = 0; x < it->size() && x < rowWidth; ++x) {
+        if ((*it)[x] != '#') setOpen(row, x);
+      }
+      rows.push_back(row);
+    }
+  }
+
+  std::size_t MemoryRowSource::width() {
+    return rowWidth;
+  }
+
+  std::size_t MemoryRowSource::height() {
+    return rows.size();
+  }
+
+  bool MemoryRowSource::nextRow(PackedRow& row) {
+    if (nextY >= rows.size()) return false;
+    row = rows[nextY++];
+    return true;
+  }
+
+  std::unique_ptr<IRowSource> openRowSource(std::string filePath) {
+    std::unique_ptr<FileByteSource> file(new FileByteSource(filePath));
+    if (!file->isOpen()) {
+      std::cout << "Error - Failed to open: " << filePath << std::endl;
+      return NULL;
+    }
+    std::unique_ptr<IRowSource> decoded = decodeRowSource(std::move(file));
+    if (decoded) return decoded;
+    std::cout << "Error - Unsupported or corrupt maze image: " << filePath << std::endl;
+    return NULL;
+  }
+}
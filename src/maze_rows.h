@@ -0,0 +1,89 @@
+#pragma once
+
+#include "maze_memory.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace mazeUtils {
+  // A single row of maze pixels packed one bit per pixel. Bit (x % 64) of
+  // word (x / 64) is set when pixel x is open (white). Rows are as wide as
+  // the maze, so they're counted by memoryTracker().
+  typedef TrackedVector<uint64_t> PackedRow;
+
+  const std::size_t BITS_PER_WORD = 64;
+
+  inline std::size_t wordsForWidth(std::size_t width) {
+    return (width + BITS_PER_WORD - 1) / BITS_PER_WORD;
+  }
+
+  inline bool isOpen(const PackedRow& row, std::size_t x) {
+    return (row[x / BITS_PER_WORD] >> (x % BITS_PER_WORD)) & 1;
+  }
+
+  inline void setOpen(PackedRow& row, std::size_t x) {
+    row[x / BITS_PER_WORD] |= uint64_t(1) << (x % BITS_PER_WORD);
+  }
+
+  // Produces the rows of a maze image from top to bottom, one at a time, so
+  // consumers never need the whole image in memory at once.
+  class IRowSource {
+    public:
+      virtual ~IRowSource() {}
+
+      virtual std::size_t width() = 0;
+      virtual std::size_t height() = 0;
+      // Fills row with the next row of the maze. Returns false once every
+      // row has been read, or if the image is truncated or corrupt.
+      virtual bool nextRow(PackedRow& row) = 0;
+      // Why nextRow returned false before the last row, or empty if it didn't
+      virtual std::string getError() {
+        return "";
+      }
+      // Memory the source will hold on to while its rows are read, beyond a
+      // row or two, so it can be counted in memory estimates
+      virtual std::size_t bufferBytes() {
+        return 0;
+      }
+  };
+
+  // Rows decoded from a 24-bit BMP through bitmap_image.
+  class BitmapRowSource : public IRowSource {
+    public:
+      BitmapRowSource(std::string filePath);
+      virtual ~BitmapRowSource();
+
+      bool isOpen();
+      virtual std::size_t width();
+      virtual std::size_t height();
+      virtual bool nextRow(PackedRow& row);
+    private:
+      class Impl;
+      std::unique_ptr<Impl> impl;
+  };
+
+  // Rows held in memory, e.g. a maze that was just generated.
+  class MemoryRowSource : public IRowSource {
+    public:
+      MemoryRowSource(std::size_t width, std::vector<PackedRow> rows);
+      // Convenience for small hand-drawn mazes: '#' is a wall, anything else is open.
+      MemoryRowSource(const std::vector<std::string>& picture);
+
+      virtual std::size_t width();
+      virtual std::size_t height();
+      virtual bool nextRow(PackedRow& row);
+    private:
+      std::size_t rowWidth;
+      std::size_t nextY = 0;
+      std::vector<PackedRow> rows;
+  };
+
+  // Opens filePath with the decoder matching its contents: BMP, PNG or the
+  // native maze format. All of them are streamed, so memory used decoding
+  // is counted by memoryTracker(). Returns NULL if the file can't be read
+  // or isn't a supported format.
+  std::unique_ptr<IRowSource> openRowSource(std::string filePath);
+}
@@ -0,0 +1,214 @@
+#include "maze_stats.h"
+
+#include "maze_memory.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <sstream>
+#include <thread>
+
+namespace mazeUtils {
+  namespace {
+    // Graphs smaller than this aren't worth starting threads for by default
+    const std::size_t PARALLEL_THRESHOLD = 1 << 16;
+
+    void countNode(MazeStats& stats, unsigned int links, bool endpoint) {
+      stats.nodes++;
+      if (endpoint) return;
+      if (links == 1) stats.deadEnds++;
+      else if (links == 2) stats.turns++;
+      else if (links >= 3) stats.junctions++;
+    }
+
+    void countCorridor(MazeStats& stats, unsigned long long length) {
+      stats.corridors++;
+      stats.corridorLength += length;
+      stats.longestCorridor = std::max(stats.longestCorridor, length);
+    }
+
+    std::size_t distance(std::size_t a, std::size_t b) {
+      return a > b ? a - b : b - a;
+    }
+
+    const MazeNetwork::Direction DIRECTIONS[] = {
+      MazeNetwork::north, MazeNetwork::south, MazeNetwork::east, MazeNetwork::west,
+      MazeNetwork::northEast, MazeNetwork::northWest, MazeNetwork::southEast, MazeNetwork::southWest
+    };
+
+    // Tallies the nodes in [begin, end). Corridors are only counted towards
+    // the south and east (and the two diagonals south), so each one is
+    // counted once.
+    template <class Iterator>
+    void tallyNodes(Iterator begin, Iterator end, MazeNetwork& maze, MazeStats& stats) {
+      for (Iterator it = begin; it != end; ++it) {
+        MazeNetwork::Node* node = *it;
+        unsigned int links = 0;
+        for (MazeNetwork::Direction direction : DIRECTIONS) {
+          MazeNetwork::Node* neighbor = node->getNeighbor(direction);
+          if (neighbor == NULL) continue;
+          links++;
+          if (direction == MazeNetwork::south || direction == MazeNetwork::east
+              || direction == MazeNetwork::southEast || direction == MazeNetwork::southWest) {
+            countCorridor(stats, MazeNetwork::linkLength(node->getX(), node->getY(), neighbor->getX(), neighbor->getY(), maze.getCellWidth()));
+          }
+        }
+        countNode(stats, links, node == maze.getStart() || node == maze.getEnd());
+      }
+    }
+
+    std::string escapeJson(const std::string& text) {
+      std::ostringstream oss;
+      for (char c : text) {
+        if (c == '"' || c == '\\') oss << '\\' << c;
+        else if ((unsigned char)c < 0x20) oss << "\\u00" << "0123456789abcdef"[(c >> 4) & 0xf] << "0123456789abcdef"[c & 0xf];
+        else oss << c;
+      }
+      return oss.str();
+    }
+  }
+
+  void MazeStats::merge(const MazeStats& other) {
+    nodes += other.nodes;
+    deadEnds += other.deadEnds;
+    turns += other.turns;
+    junctions += other.junctions;
+    corridors += other.corridors;
+    corridorLength += other.corridorLength;
+    longestCorridor = std::max(longestCorridor, other.longestCorridor);
+  }
+
+  void MazeStats::addSolution(const std::vector<RouteNode>& route, unsigned int cellWidth) {
+    solved = !route.empty();
+    solutionLength = 0;
+    solutionNodes = route.size();
+    solutionJunctions = 0;
+    if (!solved) return;
+
+    unsigned long long choices = 0;
+    for (std::size_t i = 1; i < route.size(); i++) {
+      solutionLength += MazeNetwork::linkLength(route[i-1].x, route[i-1].y, route[i].x, route[i].y, cellWidth);
+      // The entrance and exit have no way on to choose
+      if (i + 1 < route.size() && route[i].links > 0) {
+        choices += route[i].links - 1;
+        if (route[i].links >= 3) solutionJunctions++;
+      }
+    }
+    const double dx = distance(route.front().x, route.back().x);
+    const double dy = distance(route.front().y, route.back().y);
+    const double straightLine = std::sqrt(dx * dx + dy * dy);
+    tortuosity = straightLine > 0 ? solutionLength / straightLine : 1.0;
+    const std::size_t inner = route.size() > 2 ? route.size() - 2 : 0;
+    branchingFactor = inner > 0 ? (double)choices / inner : 1.0;
+  }
+
+  std::string MazeStats::toJson(std::string name) const {
+    std::ostringstream oss;
+    oss << "{";
+    if (!name.empty()) oss << "\"maze\":\"" << escapeJson(name) << "\",";
+    oss << "\"width\":" << width
+        << ",\"height\":" << height
+        << ",\"nodes\":" << nodes
+        << ",\"deadEnds\":" << deadEnds
+        << ",\"turns\":" << turns
+        << ",\"junctions\":" << junctions
+        << ",\"corridors\":" << corridors
+        << ",\"averageCorridor\":" << (corridors > 0 ? (double)corridorLength / corridors : 0.0)
+        << ",\"longestCorridor\":" << longestCorridor
+        << ",\"solved\":" << (solved ? "true" : "false");
+    if (solved) {
+      oss << ",\"solutionLength\":" << solutionLength
+          << ",\"solutionNodes\":" << solutionNodes
+          << ",\"solutionJunctions\":" << solutionJunctions
+          << ",\"tortuosity\":" << tortuosity
+          << ",\"branchingFactor\":" << branchingFactor;
+    }
+    oss << "}";
+    return oss.str();
+  }
+
+  MazeStats analyzeNetwork(MazeNetwork& maze, const std::vector<MazeNetwork::Node*>& route, unsigned int threads) {
+    MazeStats stats;
+    stats.width = maze.getWidth();
+    stats.height = maze.getHeight();
+    auto& nodes = maze.getNodes();
+
+    if (threads == 0) {
+      threads = maze.getNodeCount() < PARALLEL_THRESHOLD ? 1 : std::max(1u, std::thread::hardware_concurrency());
+    }
+    if (threads == 1) {
+      tallyNodes(nodes.begin(), nodes.end(), maze, stats);
+    } else {
+      // Give each thread an even share of the nodes
+      std::vector<MazeStats> parts(threads);
+      std::vector<std::thread> workers;
+      const std::size_t share = (nodes.size() + threads - 1) / threads;
+      for (unsigned int t = 0; t < threads; t++) {
+        const std::size_t first = std::min(nodes.size(), t * share);
+        const std::size_t last = std::min(nodes.size(), first + share);
+        workers.push_back(std::thread([&, first, last, t]() {
+          tallyNodes(nodes.begin() + first, nodes.begin() + last, maze, parts[t]);
+        }));
+      }
+      for (auto& worker : workers) worker.join();
+      for (auto& part : parts) stats.merge(part);
+    }
+
+    std::vector<MazeStats::RouteNode> steps;
+    for (MazeNetwork::Node* node : route) {
+      unsigned int links = 0;
+      for (MazeNetwork::Direction direction : DIRECTIONS) {
+        if (node->getNeighbor(direction) != NULL) links++;
+      }
+      steps.push_back({node->getX(), node->getY(), links});
+    }
+    stats.addSolution(steps, maze.getCellWidth());
+    return stats;
+  }
+
+  StatsSink::StatsSink(MazeStats& stats, std::size_t width, unsigned int cellWidth)
+  : stats(stats), cellWidth(cellWidth), newest(width), previous(width) {}
+
+  StatsSink::Handle StatsSink::addNode(std::size_t x, std::size_t y) {
+    // The node two back in this column has had all its links by now
+    finish(previous[x]);
+    previous[x] = newest[x];
+    newest[x] = Pending{true, x, y, 0, false};
+    return {x, y};
+  }
+
+  void StatsSink::connect(Handle node, Handle neighbor, MazeNetwork::Direction) {
+    find(node).links++;
+    find(neighbor).links++;
+    countCorridor(stats, MazeNetwork::linkLength(node.x, node.y, neighbor.x, neighbor.y, cellWidth));
+  }
+
+  void StatsSink::setStart(Handle node) {
+    find(node).endpoint = true;
+  }
+
+  void StatsSink::setEnd(Handle node) {
+    find(node).endpoint = true;
+  }
+
+  void StatsSink::finishAll() {
+    for (auto& node : previous) finish(node);
+    for (auto& node : newest) finish(node);
+  }
+
+  // The scanner only ever links the newest node in a column, or the one it
+  // replaced
+  StatsSink::Pending& StatsSink::find(Handle node) {
+    Pending& latest = newest[node.x];
+    if (latest.used && latest.y == node.y) return latest;
+    Pending& before = previous[node.x];
+    assert(before.used && before.y == node.y);
+    return before;
+  }
+
+  void StatsSink::finish(Pending& node) {
+    if (!node.used) return;
+    countNode(stats, node.links, node.endpoint);
+    node.used = false;
+  }
+}
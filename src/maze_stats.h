@@ -0,0 +1,109 @@
+#pragma once
+
+#include "maze_kernels.h"
+#include "maze_memory.h"
+#include "maze_rows.h"
+#include "maze_utils.h"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace mazeUtils {
+  // Per-maze metrics for capacity planning. Nodes are classified by how many
+  // links they have: dead ends have one, turns two and junctions three or
+  // more (the entrance and exit are counted apart). A corridor is a link
+  // between two neighbouring nodes, so its length is a straight (or, in
+  // eight-connected mazes, diagonal) run of pixels.
+  struct MazeStats {
+    std::size_t width = 0;
+    std::size_t height = 0;
+    unsigned long long nodes = 0;
+    unsigned long long deadEnds = 0;
+    unsigned long long turns = 0;
+    unsigned long long junctions = 0;
+    unsigned long long corridors = 0;
+    unsigned long long corridorLength = 0;
+    unsigned long long longestCorridor = 0;
+
+    // Only filled in by addSolution()
+    bool solved = false;
+    unsigned long long solutionLength = 0;
+    unsigned long long solutionNodes = 0;
+    unsigned long long solutionJunctions = 0;
+    // Solution length over the straight-line distance from entrance to exit
+    double tortuosity = 0;
+    // Average number of ways on at each node along the solution, not
+    // counting the way back
+    double branchingFactor = 0;
+
+    // A node on the solution, with the number of links it has
+    struct RouteNode {
+      std::size_t x, y;
+      unsigned int links;
+    };
+
+    // Adds up the node and corridor counts of two parts of the same maze
+    void merge(const MazeStats& other);
+    // Fills in the solution metrics from the route, entrance first, in a
+    // maze with cells cellWidth pixels across
+    void addSolution(const std::vector<RouteNode>& route, unsigned int cellWidth = 1);
+    // One line of compact JSON, tagged with name if it isn't empty
+    std::string toJson(std::string name = "") const;
+  };
+
+  // Metrics for a parsed graph and the route solve() returned for it. The
+  // nodes are split across threads; 0 uses one per core for big graphs and
+  // just the one otherwise.
+  MazeStats analyzeNetwork(MazeNetwork& maze, const std::vector<MazeNetwork::Node*>& route, unsigned int threads = 0);
+
+  // Follows the row scanner for analyzeRows(), counting each node once it
+  // can't gain any more links. A node only gains links from the next node
+  // along its row and from nodes in the next row of cells down, so it's
+  // final once two newer nodes in its column have been added. Only the two
+  // newest nodes of each column are kept.
+  class StatsSink {
+    public:
+      struct Handle {
+        std::size_t x, y;
+      };
+
+      StatsSink(MazeStats& stats, std::size_t width, unsigned int cellWidth);
+
+      Handle addNode(std::size_t x, std::size_t y);
+      void connect(Handle node, Handle neighbor, MazeNetwork::Direction direction);
+      void setStart(Handle node);
+      void setEnd(Handle node);
+      // Counts the nodes still held, once the scan is done
+      void finishAll();
+    private:
+      struct Pending {
+        bool used;
+        std::size_t x, y;
+        unsigned int links;
+        bool endpoint;
+      };
+
+      MazeStats& stats;
+      const unsigned int cellWidth;
+      TrackedVector<Pending> newest;
+      TrackedVector<Pending> previous;
+
+      Pending& find(Handle node);
+      void finish(Pending& node);
+  };
+
+  // Node and corridor metrics straight from the row scanner for a Shape
+  // maze, without building the graph: only about a row's worth of nodes is
+  // held at a time. Returns non-zero if the rows run out early.
+  template <class Shape = ClassicShape>
+  int analyzeRows(IRowSource& rows, MazeStats& stats) {
+    stats = MazeStats();
+    stats.width = rows.width();
+    stats.height = rows.height();
+    StatsSink sink(stats, rows.width(), Shape::cellWidth);
+    if (MazeNetwork::scanRows<Shape>(rows, sink) != 0) return 1;
+    sink.finishAll();
+    return 0;
+  }
+}
@@ -0,0 +1,393 @@
+#include "maze_tiles.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <queue>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifdef DEBUG
+#define LOG(x) std::cout << x << std::endl;
+#else
+#define LOG(x)
+#endif
+
+namespace mazeUtils {
+  namespace {
+    const uint64_t UNVISITED = std::numeric_limits<uint64_t>::max();
+    const uint8_t NO_DIRECTION = 0xff;
+
+    // Pixel offsets for each MazeNetwork::Direction (north, south, east, west)
+    const int X_STEP[4] = { 0, 0, 1, -1 };
+    const int Y_STEP[4] = { -1, 1, 0, 0 };
+
+    std::runtime_error ioError(const char* what) {
+      return std::runtime_error(std::string(what) + ": " + std::strerror(errno));
+    }
+  }
+
+  double TiledNetwork::CacheStats::hitRate() {
+    unsigned long long lookups = hits + misses;
+    return lookups == 0 ? 0.0 : (double)hits / lookups;
+  }
+
+  // Writes nodes straight into their tiles as the row scanner finds them
+  struct TiledNetwork::RecordSink {
+    typedef Point Handle;
+
+    RecordSink(TiledNetwork& network) : network(network) {}
+
+    Handle addNode(std::size_t x, std::size_t y) {
+      network.addRecord(x, y);
+      return {x, y};
+    }
+
+    void connect(Handle node, Handle neighbor, MazeNetwork::Direction direction) {
+      // Neighbours are always in a straight line, so one of these is zero
+      uint32_t distance = (node.x > neighbor.x ? node.x - neighbor.x : neighbor.x - node.x)
+        + (node.y > neighbor.y ? node.y - neighbor.y : neighbor.y - node.y);
+      // Only one record is touched at a time, as fetching the second tile
+      // may evict the first.
+      network.findRecord(node.x, node.y, true)->link[direction] = distance;
+      network.findRecord(neighbor.x, neighbor.y, true)->link[MazeNetwork::opposite(direction)] = distance;
+    }
+
+    void setStart(Handle node) {
+      network.start = node;
+      network.hasStart = true;
+    }
+
+    void setEnd(Handle node) {
+      network.end = node;
+      network.hasEnd = true;
+    }
+
+    TiledNetwork& network;
+  };
+
+  TiledNetwork::TiledNetwork(std::string directory, std::size_t tileSize, std::size_t cacheTiles)
+  : directory(directory),
+  tileSize(std::max<std::size_t>(tileSize, 1)),
+  cacheTiles(std::max<std::size_t>(cacheTiles, 1))
+  {
+    static_assert(sizeof(Record) == 40, "Tile records are written to disk as-is");
+  }
+
+  TiledNetwork::~TiledNetwork() {
+    closeStore();
+  }
+
+  int TiledNetwork::parseImage(std::string filePath) {
+    std::unique_ptr<IRowSource> rows = openRowSource(filePath);
+    if (!rows) return 1;
+
+    if (parse(*rows) != 0) {
+      std::string error = rows->getError();
+      std::cout << "Error - Failed to parse: " << filePath << (error.empty() ? "" : " (" + error + ")") << std::endl;
+      return 1;
+    }
+    return 0;
+  }
+
+  int TiledNetwork::parse(IRowSource& rows) {
+    closeStore();
+    if (openStore() != 0) return 1;
+
+    width = rows.width();
+    height = rows.height();
+    tilesPerRow = (width + tileSize - 1) / tileSize;
+    const std::size_t tileRows = (height + tileSize - 1) / tileSize;
+    extents.assign(tilesPerRow * tileRows, Extent{0, 0, 0});
+
+    // The scanner fills one band of tiles (tileSize rows) at a time and
+    // links its nodes back to the band above. With fewer tiles cached than
+    // that, every pixel row would evict and rewrite whole tiles, so the
+    // cache holds both bands while parsing. Each tile is then written out
+    // about once, when the band after it moves on.
+    const std::size_t solveCacheTiles = cacheTiles;
+    cacheTiles = std::max(cacheTiles, parseCacheTiles(width, tileSize));
+    RecordSink sink(*this);
+    int result;
+    try {
+      result = MazeNetwork::scanRows<ClassicShape>(rows, sink);
+    } catch (...) {
+      cacheTiles = solveCacheTiles;
+      throw;
+    }
+    cacheTiles = solveCacheTiles;
+    while (cache.size() > cacheTiles) evictTile();
+    if (result != 0 || !hasStart || !hasEnd) return 1;
+    return 0;
+  }
+
+  std::vector<TiledNetwork::Point> TiledNetwork::solve() {
+    std::vector<Point> route;
+    solutionLength = 0;
+    if (!hasStart || !hasEnd) return route;
+    if (solved) resetSolverState();
+    solved = true;
+
+    // Nodes waiting to be explored, ordered by cost so far plus the
+    // Manhattan distance to the exit. Only the frontier is held in memory.
+    struct Entry {
+      uint64_t estimate;
+      uint64_t cost;
+      Point node;
+      bool operator>(const Entry& other) const { return estimate > other.estimate; }
+    };
+    auto heuristic = [this](Point p) {
+      return (uint64_t)(p.x > end.x ? p.x - end.x : end.x - p.x)
+        + (p.y > end.y ? p.y - end.y : end.y - p.y);
+    };
+    std::priority_queue<Entry, TrackedVector<Entry>, std::greater<Entry>> open;
+
+    findRecord(start.x, start.y, true)->cost = 0;
+    open.push({heuristic(start), 0, start});
+
+    bool reachedEnd = false;
+    while (!open.empty()) {
+      Entry current = open.top();
+      open.pop();
+      if (current.node.x == end.x && current.node.y == end.y) {
+        reachedEnd = true;
+        break;
+      }
+
+      // Copy what we need before fetching any neighbouring tiles
+      Record* record = findRecord(current.node.x, current.node.y, false);
+      if (current.cost > record->cost) continue;
+      uint32_t links[4];
+      std::copy(record->link, record->link + 4, links);
+
+      for (int direction = 0; direction < 4; ++direction) {
+        if (links[direction] == 0) continue;
+        Point neighbor = {
+          current.node.x + X_STEP[direction] * (long)links[direction],
+          current.node.y + Y_STEP[direction] * (long)links[direction]
+        };
+        uint64_t neighborCost = current.cost + links[direction];
+        if (findRecord(neighbor.x, neighbor.y, false)->cost <= neighborCost) continue;
+
+        Record* neighborRecord = findRecord(neighbor.x, neighbor.y, true);
+        neighborRecord->cost = neighborCost;
+        neighborRecord->cameFrom = MazeNetwork::opposite((MazeNetwork::Direction)direction);
+        open.push({neighborCost + heuristic(neighbor), neighborCost, neighbor});
+      }
+    }
+    if (!reachedEnd) return route;
+
+    // Follow the breadcrumbs back from the exit
+    Point node = end;
+    solutionLength = findRecord(end.x, end.y, false)->cost;
+    while (true) {
+      route.push_back(node);
+      if (node.x == start.x && node.y == start.y) break;
+      Record* record = findRecord(node.x, node.y, false);
+      uint8_t direction = record->cameFrom;
+      node.x += X_STEP[direction] * (long)record->link[direction];
+      node.y += Y_STEP[direction] * (long)record->link[direction];
+    }
+    std::reverse(route.begin(), route.end());
+    return route;
+  }
+
+  unsigned long int TiledNetwork::getSolutionLength() {
+    return this->solutionLength;
+  }
+
+  std::size_t TiledNetwork::getNodeCount() {
+    return this->nodeCount;
+  }
+
+  unsigned int TiledNetwork::getLinkCount(std::size_t x, std::size_t y) {
+    Record* record = findRecord(x, y, false);
+    unsigned int links = 0;
+    for (uint32_t link : record->link) {
+      if (link != 0) links++;
+    }
+    return links;
+  }
+
+  std::size_t TiledNetwork::getTileCount() {
+    std::size_t count = 0;
+    for (auto it = extents.begin(); it != extents.end(); it++) {
+      if (it->count > 0) count++;
+    }
+    return count;
+  }
+
+  TiledNetwork::CacheStats TiledNetwork::getStats() {
+    return this->stats;
+  }
+
+  std::size_t TiledNetwork::parseCacheTiles(std::size_t width, std::size_t tileSize) {
+    tileSize = std::max<std::size_t>(tileSize, 1);
+    return 2 * ((width + tileSize - 1) / tileSize);
+  }
+
+  std::size_t TiledNetwork::estimateBytes(std::size_t width, std::size_t height,
+                                          std::size_t tileSize, std::size_t cacheTiles) {
+    tileSize = std::max<std::size_t>(tileSize, 1);
+    // Parsing caches two bands of tiles, whatever the cache size
+    cacheTiles = std::max(cacheTiles, parseCacheTiles(width, tileSize));
+    // A tile holds at most one node per 2x2 block of pixels, and its record
+    // vector may have grown to twice that
+    const std::size_t recordsPerTile = (tileSize / 2 + 1) * (tileSize / 2 + 1);
+    const std::size_t tileBytes = 2 * recordsPerTile * sizeof(Record) + sizeof(Tile);
+    const std::size_t tiles = ((width + tileSize - 1) / tileSize) * ((height + tileSize - 1) / tileSize);
+    // The A* frontier and the row scanner's buffers are about a row or column long
+    const std::size_t frontier = (width + height) * (sizeof(uint64_t) * 2 + sizeof(Point));
+    return cacheTiles * tileBytes + tiles * sizeof(Extent) + frontier;
+  }
+
+  int TiledNetwork::openStore() {
+    // The scratch file is unlinked straight away, so the kernel cleans it
+    // up however we exit.
+    std::string pattern = directory + "/mazetiles-XXXXXX";
+    std::vector<char> path(pattern.begin(), pattern.end());
+    path.push_back('\0');
+    fd = mkstemp(path.data());
+    if (fd < 0) {
+      std::cout << "Error - Failed to create tile store in: " << directory << std::endl;
+      return 1;
+    }
+    unlink(path.data());
+    return 0;
+  }
+
+  void TiledNetwork::closeStore() {
+    cache.clear();
+    cacheIndex.clear();
+    extents.clear();
+    if (fd >= 0) {
+      close(fd);
+      fd = -1;
+    }
+    fileEnd = 0;
+    nodeCount = 0;
+    hasStart = hasEnd = solved = false;
+    stats = CacheStats();
+  }
+
+  TiledNetwork::Tile& TiledNetwork::fetchTile(std::size_t id) {
+    auto cached = cacheIndex.find(id);
+    if (cached != cacheIndex.end()) {
+      stats.hits++;
+      cache.splice(cache.begin(), cache, cached->second);
+      return cache.front();
+    }
+
+    stats.misses++;
+    if (cache.size() >= cacheTiles) evictTile();
+    cache.push_front(Tile{id, {}, false});
+    cacheIndex[id] = cache.begin();
+    readTile(cache.front());
+    return cache.front();
+  }
+
+  void TiledNetwork::evictTile() {
+    Tile& victim = cache.back();
+    if (victim.dirty) writeTile(victim);
+    LOG("Evicting tile " << victim.id);
+    cacheIndex.erase(victim.id);
+    cache.pop_back();
+    stats.evictions++;
+  }
+
+  void TiledNetwork::readTile(Tile& tile) {
+    const Extent& extent = extents[tile.id];
+    tile.records.resize(extent.count);
+    if (extent.count == 0) return;
+
+    char* buffer = reinterpret_cast<char*>(tile.records.data());
+    std::size_t remaining = extent.count * sizeof(Record);
+    uint64_t offset = extent.offset;
+    while (remaining > 0) {
+      ssize_t got = pread(fd, buffer, remaining, offset);
+      if (got < 0 && errno == EINTR) continue;
+      if (got <= 0) throw ioError("Failed to read tile");
+      buffer += got;
+      offset += got;
+      remaining -= got;
+      stats.bytesRead += got;
+    }
+  }
+
+  void TiledNetwork::writeTile(Tile& tile) {
+    Extent& extent = extents[tile.id];
+    const uint32_t count = tile.records.size();
+    if (count > extent.capacity) {
+      // Outgrew its slot - move it to the end of the file with room to grow.
+      // The old slot is simply abandoned.
+      extent.capacity = std::max<uint32_t>(count * 2, 16);
+      extent.offset = fileEnd;
+      fileEnd += (uint64_t)extent.capacity * sizeof(Record);
+    }
+    extent.count = count;
+
+    const char* buffer = reinterpret_cast<const char*>(tile.records.data());
+    std::size_t remaining = count * sizeof(Record);
+    uint64_t offset = extent.offset;
+    while (remaining > 0) {
+      ssize_t put = pwrite(fd, buffer, remaining, offset);
+      if (put < 0 && errno == EINTR) continue;
+      if (put <= 0) throw ioError("Failed to write tile");
+      buffer += put;
+      offset += put;
+      remaining -= put;
+      stats.bytesWritten += put;
+    }
+    tile.dirty = false;
+  }
+
+  std::size_t TiledNetwork::tileFor(std::size_t x, std::size_t y) {
+    return (y / tileSize) * tilesPerRow + (x / tileSize);
+  }
+
+  TiledNetwork::Record* TiledNetwork::findRecord(std::size_t x, std::size_t y, bool modify) {
+    Tile& tile = fetchTile(tileFor(x, y));
+    // Records are added in scan order, so each tile is sorted by (y, x)
+    auto found = std::lower_bound(tile.records.begin(), tile.records.end(), Point{x, y},
+      [](const Record& record, const Point& p) {
+        return record.y < p.y || (record.y == p.y && record.x < p.x);
+      });
+    if (found == tile.records.end() || found->x != x || found->y != y) {
+      throw std::logic_error("No node stored at " + std::to_string(x) + "," + std::to_string(y));
+    }
+    if (modify) tile.dirty = true;
+    return &*found;
+  }
+
+  void TiledNetwork::addRecord(std::size_t x, std::size_t y) {
+    Tile& tile = fetchTile(tileFor(x, y));
+    Record record = {};
+    record.x = x;
+    record.y = y;
+    record.cost = UNVISITED;
+    record.cameFrom = NO_DIRECTION;
+    tile.records.push_back(record);
+    tile.dirty = true;
+    // Keep the extent's count current so tiles that are never evicted are
+    // still counted.
+    extents[tile.id].count = std::max<uint32_t>(extents[tile.id].count, tile.records.size());
+    nodeCount++;
+  }
+
+  void TiledNetwork::resetSolverState() {
+    for (std::size_t id = 0; id < extents.size(); ++id) {
+      if (extents[id].count == 0) continue;
+      Tile& tile = fetchTile(id);
+      for (auto it = tile.records.begin(); it != tile.records.end(); it++) {
+        it->cost = UNVISITED;
+        it->cameFrom = NO_DIRECTION;
+      }
+      tile.dirty = true;
+    }
+  }
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include "maze_memory.h"
+#include "maze_rows.h"
+#include "maze_utils.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace mazeUtils {
+  // An out-of-core alternative to MazeNetwork for mazes whose node graph
+  // doesn't fit in memory. The maze is cut into square tiles of
+  // tileSize x tileSize pixels and each tile's nodes are kept together in a
+  // scratch file on local disk. Only the cacheTiles most recently used
+  // tiles are held in memory; the rest are faulted in on demand. While
+  // parsing, the cache is raised to at least two bands of tiles across the
+  // maze (see parseCacheTiles) so that each tile is written once. The A*
+  // bookkeeping is stored in the node records as well, so solving a maze
+  // needs no more memory than parsing it.
+  class TiledNetwork {
+    public:
+      struct Point {
+        std::size_t x, y;
+      };
+
+      struct CacheStats {
+        unsigned long long hits = 0;
+        unsigned long long misses = 0;
+        unsigned long long evictions = 0;
+        unsigned long long bytesRead = 0;
+        unsigned long long bytesWritten = 0;
+
+        double hitRate();
+      };
+
+      TiledNetwork(std::string directory = ".",
+                   std::size_t tileSize = 256,
+                   std::size_t cacheTiles = 64);
+      ~TiledNetwork();
+
+      int parseImage(std::string filePath);
+      int parse(IRowSource& rows);
+      // Finds the shortest route from the entrance to the exit. Returns the
+      // locations of the nodes along it, or an empty list if there isn't one.
+      std::vector<Point> solve();
+      unsigned long int getSolutionLength();
+      std::size_t getNodeCount();
+      // Number of links the node at x,y has. Throws std::logic_error if
+      // there's no node there.
+      unsigned int getLinkCount(std::size_t x, std::size_t y);
+      // Number of tiles that contain at least one node
+      std::size_t getTileCount();
+      CacheStats getStats();
+      // Tiles parse() keeps cached however small cacheTiles is: the band of
+      // tiles being filled and the band above it
+      static std::size_t parseCacheTiles(std::size_t width, std::size_t tileSize);
+      // Rough upper bound on what parse() and solve() allocate for a maze
+      // of width x height pixels. Most of it is the tile cache.
+      static std::size_t estimateBytes(std::size_t width, std::size_t height,
+                                       std::size_t tileSize, std::size_t cacheTiles);
+    private:
+      // A node as stored on disk. link holds the distance to the neighbouring
+      // node in each MazeNetwork::Direction, or 0 if there isn't one.
+      struct Record {
+        uint32_t x, y;
+        uint32_t link[4];
+        uint64_t cost;
+        uint8_t cameFrom;
+        uint8_t reserved[7];
+      };
+
+      struct Tile {
+        std::size_t id;
+        TrackedVector<Record> records;
+        bool dirty;
+      };
+
+      // Where a tile's records live in the scratch file
+      struct Extent {
+        uint64_t offset;
+        uint32_t capacity;
+        uint32_t count;
+      };
+
+      struct RecordSink;
+
+      std::string directory;
+      std::size_t tileSize;
+      std::size_t cacheTiles;
+      int fd = -1;
+      uint64_t fileEnd = 0;
+
+      std::size_t width = 0;
+      std::size_t height = 0;
+      std::size_t tilesPerRow = 0;
+      TrackedVector<Extent> extents;
+      // Cached tiles, most recently used first
+      std::list<Tile, TrackingAllocator<Tile>> cache;
+      std::unordered_map<std::size_t, std::list<Tile, TrackingAllocator<Tile>>::iterator> cacheIndex;
+      CacheStats stats;
+
+      std::size_t nodeCount = 0;
+      bool hasStart = false;
+      bool hasEnd = false;
+      Point start = {0, 0};
+      Point end = {0, 0};
+      bool solved = false;
+      unsigned long int solutionLength = 0;
+
+      int openStore();
+      void closeStore();
+      Tile& fetchTile(std::size_t id);
+      void evictTile();
+      void readTile(Tile& tile);
+      void writeTile(Tile& tile);
+      std::size_t tileFor(std::size_t x, std::size_t y);
+      // The returned pointer is only valid until the next tile is fetched.
+      Record* findRecord(std::size_t x, std::size_t y, bool modify);
+      void addRecord(std::size_t x, std::size_t y);
+      void resetSolverState();
+  };
+}
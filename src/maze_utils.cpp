@@ -2,9 +2,12 @@
 
 #include "bitmap_image.hpp"
 
-#include <forward_list>
-#include <map>
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <queue>
 #include <sstream>
+#include <unordered_map>
 
 #ifdef DEBUG
 #define LOG(x) std::cout << x << std::endl;
@@ -14,7 +17,17 @@
 
 namespace mazeUtils {
   MazeNetwork::Node::Node() {}
-  MazeNetwork::Node::~Node() {}
+  MazeNetwork::Node::~Node() {
+    if (diagonals != NULL) memoryTracker().deallocate(diagonals, 4 * sizeof(Node*));
+  }
+
+  void* MazeNetwork::Node::operator new(std::size_t bytes) {
+    return memoryTracker().allocate(bytes);
+  }
+
+  void MazeNetwork::Node::operator delete(void* pointer, std::size_t bytes) {
+    memoryTracker().deallocate(pointer, bytes);
+  }
 
   std::size_t MazeNetwork::Node::getX() {
     return this->x;
@@ -34,8 +47,9 @@ namespace mazeUtils {
         return this->east;
       case MazeNetwork::west:
         return this->west;
+      default:
+        return diagonals == NULL ? NULL : diagonals[direction - MazeNetwork::northEast];
     }
-    return NULL;
   }
 
   unsigned long int MazeNetwork::Node::getDistance() {
@@ -61,6 +75,14 @@ namespace mazeUtils {
       case MazeNetwork::west:
         this->west = node;
         break;
+      default:
+        if (diagonals == NULL) {
+          if (node == NULL) break;
+          diagonals = static_cast<Node**>(memoryTracker().allocate(4 * sizeof(Node*)));
+          std::fill(diagonals, diagonals + 4, (Node*)NULL);
+        }
+        diagonals[direction - MazeNetwork::northEast] = node;
+        break;
     }
   }
 
@@ -84,6 +106,12 @@ namespace mazeUtils {
     if (west != NULL) {
       oss << "west: " << std::hex << west << std::endl;
     }
+    const char* diagonalNames[] = { "northEast", "northWest", "southEast", "southWest" };
+    for (int i = 0; diagonals != NULL && i < 4; i++) {
+      if (diagonals[i] != NULL) {
+        oss << diagonalNames[i] << ": " << std::hex << diagonals[i] << std::endl;
+      }
+    }
     oss << "a*: " << std::dec << distanceFromExit << std::endl;
     return oss.str();
   }
@@ -104,107 +132,113 @@ namespace mazeUtils {
   }
 
   int MazeNetwork::parseImage(std::string filePath) {
-    // TODO - Import and parse maze image
-    bitmap_image image(filePath);
-    if (!image)
-    {
-      std::cout << "Error - Failed to open: " << filePath << std::endl;
+    std::unique_ptr<IRowSource> rows = openRowSource(filePath);
+    if (!rows) return 1;
+
+    if (parse(*rows) != 0) {
+      std::string error = rows->getError();
+      std::cout << "Error - " << (error.empty() ? "No entrance or exit found" : error) << " in: " << filePath << std::endl;
       return 1;
     }
+    return 0;
+  }
 
-    const unsigned int height = image.height();
-    const unsigned int width  = image.width();
-
-    // As we parse from left-to-right, we keep track of
-    // the last node to our left that has an open space
-    // to its right (a potential connection to our west).
-    Node* westNeighbor = NULL;
-    // As we next parse top-to-bottom, we keep track of
-    // any nodes in any column that have open spaces
-    // beneath them (a potential connection to our north).
-    // This will be a map of column number (x) to the Node
-    // itself.
-    typedef std::map<std::size_t, Node*> northNeighborMap;
-    northNeighborMap northNeighbors;
-
-    // RGB values of this pixel and any neighboring pixels
-    rgb_t thisPixel, nPixel, sPixel, ePixel, wPixel;
-
-    for (std::size_t y = 0; y < height; ++y) {
-      for (std::size_t x = 0; x < width; ++x) {
-        // Look for a blank space
-        image.get_pixel(x, y, thisPixel);
-        if (!isWhite(thisPixel)) continue;
-
-        // For the first row, set the entrance
-        if (y == 0) {
-          Node* thisNode = addNode(x,y);
-          this->start = thisNode;
-          northNeighbors[x] = thisNode;
-          break;
-        }
-
-        // For the last row, set the exit
-        if (y == height-1) {
-          Node* thisNode = addNode(x,y);
-          this->end = thisNode;
-          break;
-        }
-        
-        // For any other row, check the neighboring pixels
-        image.get_pixel(x, y-1, nPixel);
-        image.get_pixel(x, y+1, sPixel);
-        image.get_pixel(x+1, y, ePixel);
-        image.get_pixel(x-1, y, wPixel);
-        if (shouldCreateNode(nPixel, sPixel, ePixel, wPixel)) {
-          Node* thisNode = addNode(x,y);
-
-          // If there's a space to the left and a previous neighbor, connect them.
-          if (isWhite(wPixel) && westNeighbor != NULL) {
-            thisNode->setNeighbor(westNeighbor, west);
-            westNeighbor->setNeighbor(thisNode, east);
-            westNeighbor = NULL;
-          }
-          // If there's a space to the north and a valid north neighbor, connect them.
-          if (isWhite(nPixel)) {
-            // Check for a north neighbor
-            Node* northNeighbor = NULL;
-            try {
-              northNeighbor = northNeighbors.at(x);
-            } catch (std::out_of_range&) {
-              northNeighbor = NULL;
-            }
-
-            // If we found one, connect them.
-            if (northNeighbor != NULL) {
-              thisNode->setNeighbor(northNeighbor, north);
-              northNeighbor->setNeighbor(thisNode, south);
-            }
-            // Regardless of whether we found one, make sure we clear this northNeighbor
-            northNeighbors.erase(x);
-          }
-          // If there's a space to the east, set ourselves as a westNeighbor
-          if (isWhite(ePixel)) {
-            westNeighbor = thisNode;
-          }
-          // If there's a space to the south, set ourselves as a northNeighbor
-          if (isWhite(sPixel)) {
-            northNeighbors[x] = thisNode;
-          }
-        }
+  std::vector<MazeNetwork::Node*> MazeNetwork::solve() {
+    std::vector<Node*> route;
+    solutionLength = 0;
+    if (this->start == NULL || this->end == NULL) return route;
+
+    // Nodes waiting to be explored, ordered by their estimated total
+    // route length (cost so far + straight-line distance to the exit).
+    typedef std::pair<double, Node*> queueEntry;
+    std::priority_queue<queueEntry, TrackedVector<queueEntry>, std::greater<queueEntry>> open;
+    // Best known cost to reach each node, and the node we reached it from
+    typedef std::pair<Node* const, unsigned long int> costEntry;
+    std::unordered_map<Node*, unsigned long int, std::hash<Node*>, std::equal_to<Node*>, TrackingAllocator<costEntry>> cost;
+    typedef std::pair<Node* const, Node*> cameFromEntry;
+    std::unordered_map<Node*, Node*, std::hash<Node*>, std::equal_to<Node*>, TrackingAllocator<cameFromEntry>> cameFrom;
+
+    cost[this->start] = 0;
+    open.push(queueEntry(std::sqrt((double)this->start->getDistance()), this->start));
+    const Direction directions[] = { north, south, east, west, northEast, northWest, southEast, southWest };
+
+    while (!open.empty()) {
+      Node* current = open.top().second;
+      double estimate = open.top().first;
+      open.pop();
+      if (current == this->end) break;
+
+      unsigned long int currentCost = cost[current];
+      // Skip stale queue entries for nodes we've since reached more cheaply
+      if (estimate > currentCost + std::sqrt((double)current->getDistance())) continue;
+
+      for (Direction direction : directions) {
+        Node* neighbor = current->getNeighbor(direction);
+        if (neighbor == NULL) continue;
+
+        unsigned long int neighborCost = currentCost
+          + linkLength(current->getX(), current->getY(), neighbor->getX(), neighbor->getY(), cellWidth);
+
+        auto known = cost.find(neighbor);
+        if (known != cost.end() && known->second <= neighborCost) continue;
+        cost[neighbor] = neighborCost;
+        cameFrom[neighbor] = current;
+        open.push(queueEntry(neighborCost + std::sqrt((double)neighbor->getDistance()), neighbor));
       }
+    }
 
-      // At the end of the row, clear our westNeighbor
-      // TODO - We might want an integrity check here in case we have any "open" rows
-      // that are looking for an east connection but don't have one
-      westNeighbor = NULL;
+    if (cost.find(this->end) == cost.end()) return route;
+    solutionLength = cost[this->end];
+    for (Node* node = this->end; node != this->start; node = cameFrom[node]) {
+      route.push_back(node);
     }
-    // Go back through all the nodes and calculate the distance from
-    // the exit for each one.
-    calculateDistances();
+    route.push_back(this->start);
+    std::reverse(route.begin(), route.end());
+    return route;
+  }
 
-    // Return success
-    return 0;
+  unsigned long int MazeNetwork::getSolutionLength() {
+    return this->solutionLength;
+  }
+
+  std::size_t MazeNetwork::getNodeCount() {
+    return this->nodeCount;
+  }
+
+  const TrackedVector<MazeNetwork::Node*>& MazeNetwork::getNodes() {
+    return this->nodeDb;
+  }
+
+  MazeNetwork::Node* MazeNetwork::getStart() {
+    return this->start;
+  }
+
+  MazeNetwork::Node* MazeNetwork::getEnd() {
+    return this->end;
+  }
+
+  std::size_t MazeNetwork::getWidth() {
+    return this->width;
+  }
+
+  std::size_t MazeNetwork::getHeight() {
+    return this->height;
+  }
+
+  unsigned int MazeNetwork::getCellWidth() {
+    return this->cellWidth;
+  }
+
+  std::size_t MazeNetwork::estimateBytes(std::size_t width, std::size_t height) {
+    // A maze with one pixel walls has at most one cell in every 2x2 block,
+    // and generated mazes put a node on about two cells in three, so a node
+    // per cell leaves some headroom. Each node costs its own allocation and
+    // its nodeDb entry (up to three while the vector grows), plus an entry in
+    // each map and the queue while solving.
+    const std::size_t nodes = (width / 2 + 1) * (height / 2 + 1);
+    const std::size_t perNode = sizeof(Node) + 3 * sizeof(void*)
+      + 2 * (4 * sizeof(void*)) + sizeof(std::pair<double, Node*>);
+    return nodes * perNode + width * (sizeof(Node*) + 1);
   }
 
   std::string MazeNetwork::toString() {
@@ -219,6 +253,38 @@ namespace mazeUtils {
     return oss.str();
   }
 
+  MazeNetwork::Direction MazeNetwork::opposite(Direction direction) {
+    switch (direction) {
+      case north:
+        return south;
+      case south:
+        return north;
+      case east:
+        return west;
+      case west:
+        return east;
+      case northEast:
+        return southWest;
+      case northWest:
+        return southEast;
+      case southEast:
+        return northWest;
+      case southWest:
+        return northEast;
+    }
+    return direction;
+  }
+
+  unsigned long int MazeNetwork::linkLength(std::size_t ax, std::size_t ay, std::size_t bx, std::size_t by, unsigned int cellWidth) {
+    std::size_t xDiff = (ax > bx ? ax - bx : bx - ax);
+    std::size_t yDiff = (ay > by ? ay - by : by - ay);
+    // Straight links have one of these zero
+    if (xDiff == 0 || yDiff == 0) return xDiff + yDiff;
+    // Diagonal ones move both ways at once
+    const bool northEastToSouthWest = (ax > bx) == (ay < by);
+    return std::max(xDiff, yDiff) + (northEastToSouthWest ? cellWidth - 1 : 0);
+  }
+
   bool MazeNetwork::isWhite(rgb_t pixel) {
     return (pixel.red == 255 && pixel.green == 255 && pixel.blue == 255);
   }
@@ -241,9 +307,11 @@ namespace mazeUtils {
 
   MazeNetwork::Node* MazeNetwork::addNode(std::size_t x, std::size_t y) {
     // Create a node and add it to the heap
-    Node* myNode = new Node();
+    std::unique_ptr<Node> newNode(new Node());
     // Add it to nodeDb for destruction later
-    nodeDb.push_front(myNode);
+    nodeDb.push_back(newNode.get());
+    Node* myNode = newNode.release();
+    nodeCount++;
     // Set the location specified by the args
     myNode->setLocation(x,y);
 
@@ -262,8 +330,12 @@ namespace mazeUtils {
       std::size_t yDiff = (y > endY ? y - endY : endY - y);
 
       // Use the Pythagorean theorem to calculate the distance.
-      // To avoid decimals, we don't do the final sqrt.
+      // To avoid decimals, we don't do the final sqrt. Diagonal moves cover
+      // a pixel both ways at once, so there the furthest way bounds it.
       unsigned long int distanceSquared = (xDiff * xDiff) + (yDiff * yDiff);
+      if (connectivity == eightConnected) {
+        distanceSquared = std::max(xDiff, yDiff) * std::max(xDiff, yDiff);
+      }
       (*it)->setDistance(distanceSquared);
     }
   }
@@ -1,7 +1,12 @@
+#pragma once
+
 #include "bitmap_image.hpp"
+#include "maze_kernels.h"
+#include "maze_memory.h"
+#include "maze_rows.h"
 
-#include <forward_list>
 #include <string>
+#include <vector>
 
 #include <gtest/gtest_prod.h>
 
@@ -10,17 +15,27 @@ const unsigned long int MAX_DISTANCE_FROM_EXIT = 0xffffffff;
 namespace mazeUtils {
   class MazeNetwork {
     public:
+      // The diagonals only link nodes of eight-connected mazes
       enum Direction {
         north,
         south,
         east,
-        west
+        west,
+        northEast,
+        northWest,
+        southEast,
+        southWest
       };
 
       class Node {
         public:
           Node();
           ~Node();
+          Node(const Node&) = delete;
+          Node& operator=(const Node&) = delete;
+          // Nodes are allocated from memoryTracker()
+          static void* operator new(std::size_t bytes);
+          static void operator delete(void* pointer, std::size_t bytes);
           std::size_t getX();
           std::size_t getY();
           Node* getNeighbor(Direction direction);
@@ -36,6 +51,9 @@ namespace mazeUtils {
           Node* south = NULL;
           Node* east = NULL;
           Node* west = NULL;
+          // Diagonal neighbours, in Direction order from northEast. Most
+          // nodes have none, so the block is only allocated for the first.
+          Node** diagonals = NULL;
           unsigned long int distanceFromExit = MAX_DISTANCE_FROM_EXIT;
       };
 
@@ -44,12 +62,68 @@ namespace mazeUtils {
       ~MazeNetwork();
 
       int parseImage(std::string filePath);
+      // Builds the graph from the rows of a Shape maze. Nodes sit on the
+      // first pixel of their cell, and routes are measured in pixels.
+      template <class Shape = ClassicShape>
+      int parse(IRowSource& rows);
+      // Finds the shortest route from the entrance to the exit with A*,
+      // using the straight-line distance to the exit as the heuristic (for
+      // eight-connected mazes, the larger of the distances across and down).
+      // Returns the nodes along the route, or an empty list if there isn't one.
+      std::vector<Node*> solve();
+      // Length in pixels of the route found by the last call to solve().
+      unsigned long int getSolutionLength();
+      std::size_t getNodeCount();
+      // Every node in the graph, in the order they were found
+      const TrackedVector<Node*>& getNodes();
+      // The entrance and exit, or NULL before a successful parse
+      Node* getStart();
+      Node* getEnd();
+      // Size of the rows the graph was parsed from
+      std::size_t getWidth();
+      std::size_t getHeight();
+      // Pixels across the cells of the shape the graph was parsed from
+      unsigned int getCellWidth();
       std::string toString();
+      // Rough upper bound on what parse() and solve() allocate for a maze
+      // of width x height pixels
+      static std::size_t estimateBytes(std::size_t width, std::size_t height);
+
+      static Direction opposite(Direction direction);
+      // Pixels along the passage between linked nodes at (ax, ay) and
+      // (bx, by) in a maze with cells cellWidth pixels across. Straight
+      // passages, and diagonals from north-west to south-east, are as long
+      // as the nodes are far apart. The other diagonal runs from a cell's
+      // bottom-left corner to the next cell's top-right one, so it crosses
+      // cellWidth - 1 more pixels.
+      static unsigned long int linkLength(std::size_t ax, std::size_t ay, std::size_t bx, std::size_t by, unsigned int cellWidth);
+      // Walks the rows of a Shape maze from top to bottom and reports every
+      // node and every link between neighbouring nodes to sink, holding only
+      // three lattice rows in memory at a time. Nodes are reported at their
+      // pixel coordinates. Sink must provide:
+      //   typedef ... Handle;
+      //   Handle addNode(std::size_t x, std::size_t y);
+      //   void connect(Handle node, Handle neighbor, Direction direction);
+      //   void setStart(Handle node);
+      //   void setEnd(Handle node);
+      // where connect links both ways and neighbor lies in direction from node.
+      // Returns non-zero if the rows run out early, or don't fit the shape.
+      template <class Shape, class Sink>
+      static int scanRows(IRowSource& pixels, Sink& sink);
     private:
       FRIEND_TEST(MazeUtilTest, verifyShouldCreateNode);
-      std::forward_list<Node*> nodeDb;
+      struct NodeSink;
+
+      TrackedVector<Node*> nodeDb;
       Node* start = NULL;
       Node* end = NULL;
+      std::size_t nodeCount = 0;
+      std::size_t width = 0;
+      std::size_t height = 0;
+      // Of the shape the graph was parsed from
+      Connectivity connectivity = fourConnected;
+      unsigned int cellWidth = 1;
+      unsigned long int solutionLength = 0;
 
       static bool isWhite(rgb_t pixel);
       static bool shouldCreateNode(rgb_t n, rgb_t s, rgb_t e, rgb_t w);
@@ -57,4 +131,211 @@ namespace mazeUtils {
       Node* addNode(std::size_t x, std::size_t y);
       void calculateDistances();
   };
-}
\ No newline at end of file
+
+  // Builds Node objects as the row scanner finds them
+  struct MazeNetwork::NodeSink {
+    typedef Node* Handle;
+
+    NodeSink(MazeNetwork& network) : network(network) {}
+
+    Handle addNode(std::size_t x, std::size_t y) {
+      return network.addNode(x, y);
+    }
+
+    void connect(Handle node, Handle neighbor, Direction direction) {
+      node->setNeighbor(neighbor, direction);
+      neighbor->setNeighbor(node, opposite(direction));
+    }
+
+    void setStart(Handle node) {
+      network.start = node;
+    }
+
+    void setEnd(Handle node) {
+      network.end = node;
+    }
+
+    MazeNetwork& network;
+  };
+
+  template <class Shape>
+  int MazeNetwork::parse(IRowSource& rows) {
+    this->width = rows.width();
+    this->height = rows.height();
+    this->connectivity = Shape::connectivity;
+    this->cellWidth = Shape::cellWidth;
+    NodeSink sink(*this);
+    if (scanRows<Shape>(rows, sink) != 0 || this->start == NULL || this->end == NULL) {
+      return 1;
+    }
+
+    // Go back through all the nodes and calculate the distance from
+    // the exit for each one.
+    calculateDistances();
+
+    // Return success
+    return 0;
+  }
+
+  template <class Shape, class Sink>
+  int MazeNetwork::scanRows(IRowSource& pixels, Sink& sink) {
+    typedef typename Sink::Handle Handle;
+    const bool diagonals = Shape::connectivity == eightConnected;
+    // The scan walks the lattice (see LatticeReader), where each cell and
+    // wall is one position, and converts back to pixels for the sink
+    LatticeReader<Shape> rows(pixels);
+    if (!rows.getError().empty()) return 1;
+    const std::size_t height = rows.height();
+    const std::size_t width = rows.width();
+    auto pixelX = [&](std::size_t x) { return Shape::latticeToPixel(x, width); };
+    auto pixelY = [&](std::size_t y) { return Shape::latticeToPixel(y, height); };
+
+    // Only the rows directly above and below the current one are kept,
+    // along with the diagonal staircases leaving their wall corners
+    PackedRow above, row, below;
+    PackedRow aboveSE, aboveSW, rowSE, rowSW, belowSE, belowSW;
+    if (height == 0 || !rows.next(row, rowSE, rowSW)) return 1;
+
+    // As we parse from left-to-right, we keep track of
+    // the last node to our left that has an open space
+    // to its right (a potential connection to our west).
+    Handle westNeighbor = Handle();
+    bool hasWestNeighbor = false;
+    // As we next parse top-to-bottom, we keep track of
+    // any nodes in any column that have open spaces
+    // beneath them (a potential connection to our north),
+    // indexed by column number (x).
+    TrackedVector<Handle> northNeighbors(width);
+    TrackedVector<bool> hasNorthNeighbor(width, false);
+    // Nodes with a diagonal passage down to the next row of cells, indexed
+    // by the column of the cell it leads to. Links into this row of cells
+    // are read from the first pair, links out of it written to the second.
+    TrackedVector<Handle> northWestNeighbors, northEastNeighbors, nextNorthWest, nextNorthEast;
+    TrackedVector<bool> hasNorthWest, hasNorthEast, hasNextNorthWest, hasNextNorthEast;
+    if (diagonals) {
+      for (auto* handles : { &northWestNeighbors, &northEastNeighbors, &nextNorthWest, &nextNorthEast }) {
+        handles->resize(width);
+      }
+      for (auto* flags : { &hasNorthWest, &hasNorthEast, &hasNextNorthWest, &hasNextNorthEast }) {
+        flags->assign(width, false);
+      }
+    }
+
+    for (std::size_t y = 0; y < height; ++y) {
+      if (y + 1 < height && !rows.next(below, belowSE, belowSW)) return 1;
+      const bool cellRow = diagonals && y % 2 == 1;
+
+      for (std::size_t x = 0; x < width; ++x) {
+        // Skip solid runs of wall a word at a time
+        if (row[x / BITS_PER_WORD] == 0) {
+          x += BITS_PER_WORD - 1 - (x % BITS_PER_WORD);
+          continue;
+        }
+        // Look for a blank space
+        if (!isOpen(row, x)) continue;
+
+        // For the first row, set the entrance
+        if (y == 0) {
+          Handle thisNode = sink.addNode(pixelX(x), pixelY(y));
+          sink.setStart(thisNode);
+          northNeighbors[x] = thisNode;
+          hasNorthNeighbor[x] = true;
+          break;
+        }
+
+        // For the last row, set the exit and connect it to the
+        // corridor above it
+        if (y == height-1) {
+          Handle thisNode = sink.addNode(pixelX(x), pixelY(y));
+          sink.setEnd(thisNode);
+          if (hasNorthNeighbor[x]) {
+            sink.connect(thisNode, northNeighbors[x], north);
+            hasNorthNeighbor[x] = false;
+          }
+          break;
+        }
+
+        // For any other row, check the neighboring pixels
+        bool n = isOpen(above, x);
+        bool s = isOpen(below, x);
+        bool e = x + 1 < width && isOpen(row, x + 1);
+        bool w = x > 0 && isOpen(row, x - 1);
+        // Only cells have diagonal passages, through the wall corners
+        // around them
+        const bool cell = cellRow && x % 2 == 1;
+        bool nw = cell && isOpen(aboveSE, x - 1);
+        bool ne = cell && isOpen(aboveSW, x + 1);
+        bool se = cell && isOpen(belowSE, x + 1);
+        bool sw = cell && isOpen(belowSW, x - 1);
+        if (nw || ne || se || sw || shouldCreateNode(n, s, e, w)) {
+          Handle thisNode = sink.addNode(pixelX(x), pixelY(y));
+
+          // If there's a space to the left and a previous neighbor, connect them.
+          if (w && hasWestNeighbor) {
+            sink.connect(thisNode, westNeighbor, west);
+            hasWestNeighbor = false;
+          }
+          // If there's a space to the north and a valid north neighbor, connect them.
+          if (n) {
+            if (hasNorthNeighbor[x]) {
+              sink.connect(thisNode, northNeighbors[x], north);
+            }
+            // Regardless of whether we found one, make sure we clear this northNeighbor
+            hasNorthNeighbor[x] = false;
+          }
+          // Diagonal passages always join neighbouring cells, which are
+          // both nodes
+          if (nw && hasNorthWest[x]) {
+            sink.connect(thisNode, northWestNeighbors[x], northWest);
+            hasNorthWest[x] = false;
+          }
+          if (ne && hasNorthEast[x]) {
+            sink.connect(thisNode, northEastNeighbors[x], northEast);
+            hasNorthEast[x] = false;
+          }
+          // If there's a space to the east, set ourselves as a westNeighbor
+          if (e) {
+            westNeighbor = thisNode;
+            hasWestNeighbor = true;
+          }
+          // If there's a space to the south, set ourselves as a northNeighbor
+          if (s) {
+            northNeighbors[x] = thisNode;
+            hasNorthNeighbor[x] = true;
+          }
+          // And likewise for the cells diagonally below
+          if (se && x + 2 < width) {
+            nextNorthWest[x + 2] = thisNode;
+            hasNextNorthWest[x + 2] = true;
+          }
+          if (sw && x >= 2) {
+            nextNorthEast[x - 2] = thisNode;
+            hasNextNorthEast[x - 2] = true;
+          }
+        }
+      }
+
+      // At the end of the row, clear our westNeighbor
+      // TODO - We might want an integrity check here in case we have any "open" rows
+      // that are looking for an east connection but don't have one
+      hasWestNeighbor = false;
+
+      if (cellRow) {
+        northWestNeighbors.swap(nextNorthWest);
+        northEastNeighbors.swap(nextNorthEast);
+        hasNorthWest.swap(hasNextNorthWest);
+        hasNorthEast.swap(hasNextNorthEast);
+        hasNextNorthWest.assign(width, false);
+        hasNextNorthEast.assign(width, false);
+      }
+
+      above.swap(row);
+      row.swap(below);
+      aboveSE.swap(rowSE);
+      rowSE.swap(belowSE);
+      aboveSW.swap(rowSW);
+      rowSW.swap(belowSW);
+    }
+    return 0;
+  }
+}
@@ -1,7 +1,17 @@
 #include "gtest/gtest.h"
 
+#include "maze_bitsolver.h"
+#include "maze_format.h"
+#include "maze_kernels.h"
+#include "maze_memory.h"
+#include "maze_pipeline.h"
+#include "maze_stats.h"
+#include "maze_tiles.h"
 #include "maze_utils.h"
 
+#include <cstdio>
+#include <fstream>
+
 class SampleTest : public ::testing::Test {
     protected:
     // You can remove any or all of the following functions if their bodies would
@@ -85,6 +95,501 @@ namespace mazeUtils {
     }
 }
 
+namespace mazeUtils {
+    class BitGridSolverTest : public ::testing::Test {};
+    TEST(BitGridSolverTest, solvesAcrossWordBoundaries) {
+        // Wide enough that the path has to carry between 64-bit words
+        std::string open(70, ' ');
+        std::string wall(70, '#');
+        std::vector<std::string> picture = { wall, wall, wall, wall, wall };
+        picture[0][1] = ' ';
+        picture[1] = "#" + open.substr(0, 68) + "#";
+        picture[2][68] = ' ';
+        picture[3] = "#" + open.substr(0, 68) + "#";
+        picture[4][1] = ' ';
+
+        MemoryRowSource rows(picture);
+        BitGridSolver solver;
+        ASSERT_EQ(solver.load(rows), 0);
+        ASSERT_TRUE(solver.solve());
+
+        auto path = solver.getPath();
+        // Down one, across 67, down two, back 67, down one
+        EXPECT_EQ(path.size() - 1, 4 + 67 * 2);
+        EXPECT_EQ(path.front().y, 0);
+        EXPECT_EQ(path.back().y, 4);
+        for (std::size_t i = 1; i < path.size(); ++i) {
+            std::size_t step = (path[i].x > path[i-1].x ? path[i].x - path[i-1].x : path[i-1].x - path[i].x)
+                + (path[i].y > path[i-1].y ? path[i].y - path[i-1].y : path[i-1].y - path[i].y);
+            EXPECT_EQ(step, 1) << "at step " << i;
+        }
+    }
+
+    TEST(BitGridSolverTest, reportsUnreachableExit) {
+        MemoryRowSource rows(std::vector<std::string>{
+            "# ###",
+            "# # #",
+            "#####",
+            "### #"
+        });
+        BitGridSolver solver;
+        ASSERT_EQ(solver.load(rows), 0);
+        EXPECT_FALSE(solver.solve());
+        EXPECT_TRUE(solver.getPath().empty());
+    }
+}
+
+namespace mazeUtils {
+    TEST(MazeKernelsTest, samplesWideCellsDownToLattice) {
+        // 4:2:1 - two pixel cells behind one pixel walls
+        MemoryRowSource pixels(std::vector<std::string>{
+            "#  ####",
+            "#  #  #",
+            "#  #  #",
+            "#  ####",
+            "#     #",
+            "#     #",
+            "####  #"
+        });
+        LatticeRowSource<MazeShape<fourConnected, 2, 1>> lattice(pixels);
+        MemoryRowSource expected(std::vector<std::string>{
+            "# ###",
+            "# # #",
+            "# ###",
+            "#   #",
+            "### #"
+        });
+        ASSERT_EQ(lattice.width(), expected.width());
+        ASSERT_EQ(lattice.height(), expected.height());
+        PackedRow actualRow, expectedRow;
+        while (expected.nextRow(expectedRow)) {
+            ASSERT_TRUE(lattice.nextRow(actualRow));
+            EXPECT_EQ(actualRow, expectedRow);
+        }
+        EXPECT_FALSE(lattice.nextRow(actualRow));
+    }
+
+    TEST(MazeKernelsTest, rejectsImagesNotMadeOfWholeCells) {
+        // One pixel too wide for 4:2:1
+        MemoryRowSource pixels(std::vector<std::string>{
+            "#  #####",
+            "#  #  ##",
+            "#  #  ##",
+            "#  #####",
+            "#     ##",
+            "#     ##",
+            "####  ##"
+        });
+        LatticeRowSource<MazeShape<fourConnected, 2, 1>> lattice(pixels);
+        PackedRow row;
+        EXPECT_FALSE(lattice.nextRow(row));
+        EXPECT_FALSE(lattice.getError().empty());
+
+        const SolverKernels* kernels = findSolverKernels("4:2:1");
+        ASSERT_TRUE(kernels != NULL);
+        EXPECT_FALSE(kernels->fits(pixels.width(), pixels.height()));
+        EXPECT_TRUE(kernels->fits(7, 7));
+        MemoryRowSource graphRows(std::vector<std::string>(7, std::string(8, '#')));
+        MazeNetwork network;
+        EXPECT_EQ(kernels->parseGraph(network, graphRows), 1);
+    }
+
+    TEST(MazeKernelsTest, eightConnectedKernelsFollowDiagonals) {
+        // 8:2:2 - the only way through is the staircase between the two cells
+        std::vector<std::string> picture = {
+            "##  ######",
+            "##  ######",
+            "##  ######",
+            "##  ######",
+            "#### #####",
+            "##### ####",
+            "######  ##",
+            "######  ##",
+            "######  ##",
+            "######  ##"
+        };
+        const SolverKernels* kernels = findSolverKernels("8:2:2");
+        ASSERT_TRUE(kernels != NULL);
+        EXPECT_TRUE(findSolverKernels("8:1:1") == NULL);
+
+        MemoryRowSource graphRows(picture);
+        MazeNetwork network;
+        ASSERT_EQ(kernels->parseGraph(network, graphRows), 0);
+        auto route = network.solve();
+        ASSERT_EQ(route.size(), 4);
+        // The cells' top-left pixels, linked diagonally through the staircase
+        EXPECT_EQ(route[1]->getX(), 2);
+        EXPECT_EQ(route[1]->getY(), 2);
+        EXPECT_EQ(route[1]->getNeighbor(MazeNetwork::southEast), route[2]);
+        EXPECT_EQ(route[2]->getNeighbor(MazeNetwork::northWest), route[1]);
+        EXPECT_EQ(route[3]->getY(), 9);
+        EXPECT_EQ(network.getSolutionLength(), 9);
+
+        MemoryRowSource rows(picture);
+        BitGridSolver solver;
+        ASSERT_EQ(kernels->loadGrid(solver, rows), 0);
+        ASSERT_TRUE(kernels->solveGrid(solver));
+        // Three down, two diagonal steps, one more diagonal into the cell, then three down
+        EXPECT_EQ(solver.getPath().size() - 1, 9);
+
+        MemoryRowSource fourConnectedRows(picture);
+        BitGridSolver fourConnectedSolver;
+        ASSERT_EQ(fourConnectedSolver.load(fourConnectedRows), 0);
+        EXPECT_FALSE(fourConnectedSolver.solve());
+    }
+
+    TEST(MazeKernelsTest, graphMeasuresSouthWestDiagonalsCornerToCorner) {
+        // The mirror image of the maze above
+        std::vector<std::string> picture = {
+            "######  ##",
+            "######  ##",
+            "######  ##",
+            "######  ##",
+            "##### ####",
+            "#### #####",
+            "##  ######",
+            "##  ######",
+            "##  ######",
+            "##  ######"
+        };
+        const SolverKernels* kernels = findSolverKernels("8:2:2");
+        ASSERT_TRUE(kernels != NULL);
+
+        MemoryRowSource graphRows(picture);
+        MazeNetwork network;
+        ASSERT_EQ(kernels->parseGraph(network, graphRows), 0);
+        auto route = network.solve();
+        ASSERT_EQ(route.size(), 4);
+        EXPECT_EQ(route[1]->getNeighbor(MazeNetwork::southWest), route[2]);
+        // The staircase leaves the first cell from its bottom-left corner and
+        // enters the second at its top-right, one pixel from the node
+        EXPECT_EQ(MazeNetwork::linkLength(6, 2, 2, 6, 2), 5);
+        EXPECT_EQ(network.getSolutionLength(), 10);
+
+        // Following the pixels, the route can hug the inside of the cells
+        MemoryRowSource rows(picture);
+        BitGridSolver solver;
+        ASSERT_EQ(kernels->loadGrid(solver, rows), 0);
+        ASSERT_TRUE(kernels->solveGrid(solver));
+        EXPECT_EQ(solver.getPath().size() - 1, 9);
+
+        MazeStats stats;
+        MemoryRowSource statsRows(picture);
+        typedef MazeShape<eightConnected, 2, 2> Shape;
+        ASSERT_EQ(analyzeRows<Shape>(statsRows, stats), 0);
+        EXPECT_EQ(stats.nodes, 4);
+        EXPECT_EQ(stats.corridors, 3);
+        EXPECT_EQ(stats.corridorLength, 10);
+    }
+}
+
+namespace mazeUtils {
+    // A small maze with a few dead ends, shared by the tests below
+    const std::vector<std::string> SMALL_MAZE = {
+        "### #######",
+        "#   #     #",
+        "# ### ### #",
+        "#     #   #",
+        "##### # ###",
+        "#     #   #",
+        "# ####### #",
+        "#         #",
+        "######### #"
+    };
+
+    void expectRowsMatch(IRowSource& rows, const std::vector<std::string>& picture) {
+        ASSERT_EQ(rows.width(), picture[0].size());
+        ASSERT_EQ(rows.height(), picture.size());
+        PackedRow row;
+        for (std::size_t y = 0; y < picture.size(); ++y) {
+            ASSERT_TRUE(rows.nextRow(row)) << "row " << y;
+            for (std::size_t x = 0; x < picture[y].size(); ++x) {
+                EXPECT_EQ(isOpen(row, x), picture[y][x] != '#') << "x" << x << " y" << y;
+            }
+        }
+        EXPECT_FALSE(rows.nextRow(row));
+    }
+
+    class TiledNetworkTest : public ::testing::Test {};
+    TEST(TiledNetworkTest, matchesInMemoryNetworkWithTinyCache) {
+        const std::vector<std::string>& picture = SMALL_MAZE;
+        MemoryRowSource graphRows(picture);
+        MazeNetwork network;
+        ASSERT_EQ(network.parse(graphRows), 0);
+        ASSERT_FALSE(network.solve().empty());
+
+        // Tiles of 2x2 pixels with a single tile cached forces a fault on
+        // almost every lookup
+        MemoryRowSource tiledRows(picture);
+        TiledNetwork tiled(".", 2, 1);
+        ASSERT_EQ(tiled.parse(tiledRows), 0);
+        // Parsing keeps two bands of tiles cached, so nothing is read back
+        EXPECT_EQ(tiled.getStats().bytesRead, 0);
+        auto route = tiled.solve();
+        ASSERT_FALSE(route.empty());
+
+        EXPECT_EQ(tiled.getNodeCount(), network.getNodeCount());
+        EXPECT_EQ(tiled.getSolutionLength(), network.getSolutionLength());
+        EXPECT_EQ(route.front().y, 0);
+        EXPECT_EQ(route.back().y, picture.size() - 1);
+        EXPECT_GT(tiled.getStats().evictions, 0);
+        EXPECT_GT(tiled.getStats().bytesRead, 0);
+
+        // Solving again must start from a clean slate
+        tiled.solve();
+        EXPECT_EQ(tiled.getSolutionLength(), network.getSolutionLength());
+    }
+}
+
+namespace mazeUtils {
+    class MazeFormatTest : public ::testing::Test {};
+    TEST(MazeFormatTest, nativeFormatRoundTrips) {
+        for (bool rle : { true, false }) {
+            // Wide rows so both packed and run-length rows get written
+            std::vector<std::string> picture = SMALL_MAZE;
+            for (auto& line : picture) line += std::string(70, line[line.size() - 2]);
+
+            MemoryRowSource rows(picture);
+            NativeMazeWriter writer("format_test.maze", rows.width(), rows.height(), rle);
+            ASSERT_TRUE(writer.isOpen());
+            PackedRow row;
+            while (rows.nextRow(row)) writer.writeRow(row);
+            ASSERT_TRUE(writer.close());
+
+            auto decoded = openRowSource("format_test.maze");
+            ASSERT_TRUE(decoded != NULL);
+            expectRowsMatch(*decoded, picture);
+        }
+        std::remove("format_test.maze");
+    }
+
+    TEST(MazeFormatTest, reportsTruncatedNativeFile) {
+        MemoryRowSource rows(SMALL_MAZE);
+        NativeMazeWriter writer("truncated_test.maze", rows.width(), rows.height(), false);
+        PackedRow row;
+        while (rows.nextRow(row)) writer.writeRow(row);
+        ASSERT_TRUE(writer.close());
+
+        std::vector<uint8_t> bytes(4096);
+        FileByteSource file("truncated_test.maze");
+        bytes.resize(file.read(bytes.data(), bytes.size()));
+        std::remove("truncated_test.maze");
+        bytes.resize(bytes.size() - 3);
+
+        // Stops short like any other source, rather than throwing
+        auto truncated = decodeRowSource(std::unique_ptr<IByteSource>(new MemoryByteSource(bytes)));
+        ASSERT_TRUE(truncated != NULL);
+        MazeNetwork maze;
+        EXPECT_EQ(maze.parse(*truncated), 1);
+        EXPECT_NE(truncated->getError().find("Maze file ended"), std::string::npos) << truncated->getError();
+    }
+
+    TEST(MazeFormatTest, decodesPng) {
+        // SMALL_MAZE as 8-bit RGB, one filter type per row, split over two IDAT chunks
+        std::vector<uint8_t> png = {
+            0x89, 0x50, 0x4e, 0x47, 0x0d, 0x0a, 0x1a, 0x0a, 0x00, 0x00, 0x00, 0x0d, 0x49, 0x48, 0x44, 0x52,
+            0x00, 0x00, 0x00, 0x0b, 0x00, 0x00, 0x00, 0x09, 0x08, 0x02, 0x00, 0x00, 0x00, 0x6b, 0x06, 0x41,
+            0x7a, 0x00, 0x00, 0x00, 0x0c, 0x74, 0x45, 0x58, 0x74, 0x43, 0x6f, 0x6d, 0x6d, 0x65, 0x6e, 0x74,
+            0x00, 0x6d, 0x61, 0x7a, 0x65, 0xc6, 0x0b, 0x00, 0x9b, 0x00, 0x00, 0x00, 0x28, 0x49, 0x44, 0x41,
+            0x54, 0x78, 0xda, 0x75, 0x8e, 0x01, 0x0e, 0x80, 0x30, 0x08, 0x03, 0x41, 0x7d, 0xb8, 0xbc, 0xbc,
+            0xeb, 0x62, 0x84, 0x6e, 0xe2, 0x25, 0x5b, 0x4a, 0x47, 0x97, 0x9a, 0xbd, 0x00, 0xb0, 0x0e, 0xd7,
+            0x37, 0x77, 0xdf, 0xf6, 0xe8, 0x1c, 0xa9, 0x88, 0xea, 0xc8, 0x5f, 0x9a, 0x5b, 0x00, 0x00, 0x00,
+            0x25, 0x49, 0x44, 0x41, 0x54, 0x1c, 0x4f, 0x9e, 0x5b, 0xe0, 0x18, 0x11, 0xfc, 0x29, 0xf5, 0xf5,
+            0x84, 0xbe, 0x6d, 0xd4, 0x9c, 0xae, 0xa2, 0x4e, 0x35, 0x5d, 0x12, 0x92, 0xac, 0xa6, 0xe8, 0xa8,
+            0xa6, 0xf1, 0x03, 0xcb, 0xf2, 0x1e, 0x7f, 0xa5, 0x5b, 0x91, 0xb9, 0x75, 0xb8, 0xa3, 0x00, 0x00,
+            0x00, 0x00, 0x49, 0x45, 0x4e, 0x44, 0xae, 0x42, 0x60, 0x82
+        };
+        auto decoded = decodeRowSource(std::unique_ptr<IByteSource>(new MemoryByteSource(png)));
+        ASSERT_TRUE(decoded != NULL);
+        expectRowsMatch(*decoded, SMALL_MAZE);
+
+        // A bad zlib header fails the decoder up front, from memory or a file,
+        // rather than throwing
+        std::vector<uint8_t> corrupt = png;
+        ASSERT_EQ(corrupt[65], 0x78);
+        corrupt[65] = 0x79;
+        std::unique_ptr<IRowSource> rejected;
+        EXPECT_NO_THROW(rejected = decodeRowSource(std::unique_ptr<IByteSource>(new MemoryByteSource(corrupt))));
+        EXPECT_TRUE(rejected == NULL);
+        {
+            std::ofstream file("corrupt_test.png", std::ios::binary);
+            file.write(reinterpret_cast<const char*>(corrupt.data()), corrupt.size());
+        }
+        std::size_t width, height, bufferBytes;
+        EXPECT_FALSE(readMazeSize("corrupt_test.png", width, height, bufferBytes));
+        EXPECT_NO_THROW(rejected = openRowSource("corrupt_test.png"));
+        EXPECT_TRUE(rejected == NULL);
+        std::remove("corrupt_test.png");
+
+        // A hostile width costs nothing until rows are read, and then the
+        // row buffers count against the budget
+        std::vector<uint8_t> wide = png;
+        wide[16] = 0x40;
+        {
+            std::ofstream file("wide_test.png", std::ios::binary);
+            file.write(reinterpret_cast<const char*>(wide.data()), wide.size());
+        }
+        MemoryTracker& tracker = memoryTracker();
+        const std::size_t baseline = tracker.getCurrentBytes();
+        tracker.resetStats();
+        ASSERT_TRUE(readMazeSize("wide_test.png", width, height, bufferBytes));
+        EXPECT_EQ(width, 0x4000000b);
+        EXPECT_EQ(tracker.getPeakBytes(), baseline);
+        tracker.setBudget(baseline + (1 << 20));
+        rejected = openRowSource("wide_test.png");
+        ASSERT_TRUE(rejected != NULL);
+        PackedRow wideRow;
+        EXPECT_THROW(rejected->nextRow(wideRow), MemoryBudgetExceeded);
+        tracker.setBudget(0);
+        std::remove("wide_test.png");
+
+        // Cutting the image data short must be reported, not silently padded
+        png.resize(100);
+        auto truncated = decodeRowSource(std::unique_ptr<IByteSource>(new MemoryByteSource(png)));
+        ASSERT_TRUE(truncated != NULL);
+        PackedRow row;
+        while (truncated->nextRow(row)) {}
+        EXPECT_FALSE(truncated->getError().empty());
+    }
+}
+
+namespace mazeUtils {
+    class MazePipelineTest : public ::testing::Test {};
+    TEST(MazePipelineTest, solvesBatchInOrderAndReportsFailures) {
+        MemoryRowSource rows(SMALL_MAZE);
+        NativeMazeWriter writer("pipeline_test.maze", rows.width(), rows.height());
+        PackedRow row;
+        while (rows.nextRow(row)) writer.writeRow(row);
+        ASSERT_TRUE(writer.close());
+
+        MazeNetwork reference;
+        MemoryRowSource referenceRows(SMALL_MAZE);
+        ASSERT_EQ(reference.parse(referenceRows), 0);
+        reference.solve();
+
+        for (std::string engine : { "graph", "bitgrid" }) {
+            MazePipeline::Options options;
+            options.engine = engine;
+            // Tiny blocks so each maze arrives in several pieces
+            options.blockSize = 4096;
+            options.parseWorkers = 2;
+            MazePipeline pipeline(options);
+            auto results = pipeline.run({ "pipeline_test.maze", "missing_test.maze", "pipeline_test.maze" });
+
+            ASSERT_EQ(results.size(), 3);
+            EXPECT_TRUE(results[0].solved) << engine << ": " << results[0].error;
+            EXPECT_EQ(results[0].solutionLength, reference.getSolutionLength()) << engine;
+            EXPECT_FALSE(results[1].solved) << engine;
+            EXPECT_FALSE(results[1].error.empty()) << engine;
+            EXPECT_TRUE(results[2].solved) << engine << ": " << results[2].error;
+            EXPECT_EQ(pipeline.getStageReports().size(), 3);
+        }
+        std::remove("pipeline_test.maze");
+    }
+
+    TEST(MazePipelineTest, sharesMemoryBudgetBetweenMazes) {
+        MemoryRowSource rows(SMALL_MAZE);
+        NativeMazeWriter writer("pipeline_budget_test.maze", rows.width(), rows.height());
+        PackedRow row;
+        while (rows.nextRow(row)) writer.writeRow(row);
+        ASSERT_TRUE(writer.close());
+
+        // Room for one maze at a time, so the others have to wait their turn
+        MemoryTracker& tracker = memoryTracker();
+        const std::size_t estimate = MazeNetwork::estimateBytes(rows.width(), rows.height());
+        tracker.resetStats();
+        tracker.setBudget(tracker.getCurrentBytes() + estimate + estimate / 2);
+        MazePipeline::Options options;
+        options.parseWorkers = 3;
+        MazePipeline pipeline(options);
+        const std::vector<std::string> batch(4, "pipeline_budget_test.maze");
+        for (auto& result : pipeline.run(batch)) {
+            EXPECT_TRUE(result.solved) << result.error;
+        }
+
+        // Mazes that could never fit are refused up front
+        tracker.setBudget(tracker.getCurrentBytes() + estimate / 2);
+        MazePipeline tooSmall(options);
+        for (auto& result : tooSmall.run(batch)) {
+            EXPECT_FALSE(result.solved);
+            EXPECT_NE(result.error.find("memory budget"), std::string::npos) << result.error;
+        }
+        tracker.setBudget(0);
+        std::remove("pipeline_budget_test.maze");
+    }
+}
+
+namespace mazeUtils {
+    TEST(MemoryTrackerTest, tracksPeakAndEnforcesBudget) {
+        MemoryTracker& tracker = memoryTracker();
+        const std::size_t baseline = tracker.getCurrentBytes();
+        tracker.resetStats();
+        {
+            MazeNetwork maze;
+            MemoryRowSource rows(SMALL_MAZE);
+            ASSERT_EQ(maze.parse(rows), 0);
+            EXPECT_GE(tracker.getPeakBytes() - baseline, maze.getNodeCount() * sizeof(MazeNetwork::Node));
+            EXPECT_GE(tracker.getAllocationCount(), maze.getNodeCount());
+        }
+        EXPECT_EQ(tracker.getCurrentBytes(), baseline);
+
+        // Parsing fails part way through once the budget runs out, and
+        // everything allocated up to then is handed back
+        tracker.resetStats();
+        tracker.setBudget(baseline + 4 * sizeof(MazeNetwork::Node));
+        {
+            MazeNetwork maze;
+            MemoryRowSource rows(SMALL_MAZE);
+            EXPECT_THROW(maze.parse(rows), MemoryBudgetExceeded);
+        }
+        tracker.setBudget(0);
+        EXPECT_EQ(tracker.getCurrentBytes(), baseline);
+        EXPECT_LE(tracker.getPeakBytes(), baseline + 4 * sizeof(MazeNetwork::Node));
+    }
+
+    TEST(MazeStatsTest, graphAndStreamingStatsAgree) {
+        MazeNetwork maze;
+        MemoryRowSource rows(SMALL_MAZE);
+        ASSERT_EQ(maze.parse(rows), 0);
+        auto route = maze.solve();
+        ASSERT_FALSE(route.empty());
+
+        MazeStats graph = analyzeNetwork(maze, route, 1);
+        EXPECT_EQ(graph.width, 11);
+        EXPECT_EQ(graph.height, 9);
+        EXPECT_EQ(graph.nodes, maze.getNodeCount());
+        EXPECT_EQ(graph.deadEnds, 0);
+        EXPECT_EQ(graph.junctions, 2);
+        EXPECT_EQ(graph.nodes, graph.deadEnds + graph.turns + graph.junctions + 2);
+        // The two junctions close a loop, so there's one corridor more than a tree would have
+        EXPECT_EQ(graph.corridors, graph.nodes);
+        EXPECT_EQ(graph.longestCorridor, 8);
+        EXPECT_TRUE(graph.solved);
+        EXPECT_EQ(graph.solutionLength, maze.getSolutionLength());
+        EXPECT_EQ(graph.solutionNodes, route.size());
+        EXPECT_GT(graph.tortuosity, 1.0);
+
+        // Splitting the nodes across threads adds up to the same thing
+        MazeStats split = analyzeNetwork(maze, route, 3);
+        EXPECT_EQ(split.toJson(), graph.toJson());
+
+        // The streaming pass sees the same nodes and corridors without the graph
+        MazeStats streamed;
+        MemoryRowSource streamedRows(SMALL_MAZE);
+        ASSERT_EQ(analyzeRows(streamedRows, streamed), 0);
+        EXPECT_EQ(streamed.nodes, graph.nodes);
+        EXPECT_EQ(streamed.deadEnds, graph.deadEnds);
+        EXPECT_EQ(streamed.turns, graph.turns);
+        EXPECT_EQ(streamed.junctions, graph.junctions);
+        EXPECT_EQ(streamed.corridors, graph.corridors);
+        EXPECT_EQ(streamed.corridorLength, graph.corridorLength);
+        EXPECT_EQ(streamed.longestCorridor, graph.longestCorridor);
+        EXPECT_FALSE(streamed.solved);
+        EXPECT_NE(streamed.toJson().find("\"solved\":false}"), std::string::npos);
+        EXPECT_EQ(graph.toJson("a \"maze\"").find("{\"maze\":\"a \\\"maze\\\"\",\"width\":11,"), 0);
+    }
+}
+
 int main(int argc, char **argv) {
   ::testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
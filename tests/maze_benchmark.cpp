@@ -0,0 +1,179 @@
+#include "maze_bitsolver.h"
+#include "maze_builder.h"
+#include "maze_utils.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Times the graph and bitgrid engines against each other on generated
+// mazes across a range of sizes and densities. Density is varied by
+// knocking out a fraction of the walls that a perfect maze leaves between
+// neighbouring cells: 0 keeps the maze perfect (a single route and long
+// dead ends), 1 removes every one of them (an open room of pillars).
+namespace mazeUtils {
+    typedef std::chrono::steady_clock Clock;
+
+    struct BenchmarkSettings {
+        std::vector<unsigned int> sizes = { 501, 1001, 2001 };
+        std::vector<double> loops = { 0, 0.02, 0.1, 0.3, 1 };
+        unsigned long seed = 1;
+        // Each timing is the best of this many runs
+        unsigned int repeat = 3;
+    };
+
+    class QuietStdout {
+        public:
+            QuietStdout() : saved(std::cout.rdbuf(sink.rdbuf())) {}
+            ~QuietStdout() { std::cout.rdbuf(saved); }
+        private:
+            std::ostringstream sink;
+            std::streambuf* saved;
+    };
+
+    double secondsSince(Clock::time_point t1) {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - t1).count() / 1000000000.0;
+    }
+
+    // Opens each wall between two cells of the classic lattice (odd
+    // coordinates are cells) with probability fraction. The border is left alone.
+    void openWalls(std::vector<PackedRow>& rows, std::size_t width, double fraction, unsigned long seed) {
+        std::mt19937 random(seed);
+        std::bernoulli_distribution knockOut(fraction);
+        for (std::size_t y = 1; y + 1 < rows.size(); ++y) {
+            for (std::size_t x = 1; x + 1 < width; ++x) {
+                const bool betweenCells = (x % 2 == 0) != (y % 2 == 0);
+                if (betweenCells && !isOpen(rows[y], x) && knockOut(random)) setOpen(rows[y], x);
+            }
+        }
+    }
+
+    double openFraction(const std::vector<PackedRow>& rows, std::size_t width) {
+        std::size_t open = 0;
+        for (auto& row : rows) {
+            for (uint64_t word : row) open += __builtin_popcountll(word);
+        }
+        return rows.empty() ? 0 : (double)open / (width * rows.size());
+    }
+
+    struct Timings {
+        double graphParse = 0, graphSolve = 0;
+        double gridLoad = 0, gridSolve = 0;
+        std::size_t nodes = 0;
+        unsigned long graphLength = 0, gridLength = 0;
+    };
+
+    Timings timeEngines(const std::vector<PackedRow>& rows, std::size_t width, unsigned int repeat) {
+        Timings best;
+        for (unsigned int run = 0; run < repeat; ++run) {
+            Timings t;
+            {
+                MemoryRowSource source(width, rows);
+                auto t1 = Clock::now();
+                MazeNetwork graph;
+                graph.parse(source);
+                t.graphParse = secondsSince(t1);
+                auto t2 = Clock::now();
+                graph.solve();
+                t.graphSolve = secondsSince(t2);
+                t.nodes = graph.getNodeCount();
+                t.graphLength = graph.getSolutionLength();
+            }
+            {
+                MemoryRowSource source(width, rows);
+                auto t1 = Clock::now();
+                BitGridSolver grid;
+                grid.load(source);
+                t.gridLoad = secondsSince(t1);
+                auto t2 = Clock::now();
+                bool solved = grid.solve();
+                t.gridSolve = secondsSince(t2);
+                t.gridLength = solved ? grid.getPath().size() - 1 : 0;
+            }
+            if (run == 0 || t.graphParse + t.graphSolve < best.graphParse + best.graphSolve) {
+                best.graphParse = t.graphParse;
+                best.graphSolve = t.graphSolve;
+            }
+            if (run == 0 || t.gridLoad + t.gridSolve < best.gridLoad + best.gridSolve) {
+                best.gridLoad = t.gridLoad;
+                best.gridSolve = t.gridSolve;
+            }
+            best.nodes = t.nodes;
+            best.graphLength = t.graphLength;
+            best.gridLength = t.gridLength;
+        }
+        return best;
+    }
+
+    template <class T>
+    std::vector<T> parseList(std::string text) {
+        std::vector<T> values;
+        std::istringstream in(text);
+        std::string item;
+        while (std::getline(in, item, ',')) {
+            std::istringstream value(item);
+            T parsed;
+            if (value >> parsed) values.push_back(parsed);
+        }
+        return values;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    mazeUtils::BenchmarkSettings settings;
+    for (int i = 1; i < argc; i++) {
+        std::string arg(argv[i]);
+        if (arg == "--sizes" && i + 1 < argc) {
+            settings.sizes = mazeUtils::parseList<unsigned int>(argv[++i]);
+        }
+        else if (arg == "--loops" && i + 1 < argc) {
+            settings.loops = mazeUtils::parseList<double>(argv[++i]);
+        }
+        else if (arg == "--seed" && i + 1 < argc) {
+            settings.seed = std::stoul(std::string(argv[++i]));
+        }
+        else if (arg == "--repeat" && i + 1 < argc) {
+            settings.repeat = std::max(1ul, std::stoul(std::string(argv[++i])));
+        }
+        else {
+            std::cerr << "Usage: maze-benchmark [--sizes 501,1001] [--loops 0,0.1,1] [--seed <n>] [--repeat <n>]" << std::endl;
+            return 1;
+        }
+    }
+
+    std::cout << std::fixed << std::setprecision(4);
+    std::cout << "size\tloops\topen\tnodes\tgraph parse\tgraph solve\tbitgrid load\tbitgrid solve\tbitgrid speedup" << std::endl;
+    int result = 0;
+    for (unsigned int size : settings.sizes) {
+        std::vector<mazeUtils::PackedRow> perfect;
+        unsigned int width;
+        {
+            mazeUtils::QuietStdout quiet;
+            mazeBuilder::DepthFirstBuilder builder(settings.seed, size, size);
+            perfect = builder.makeRows();
+            width = builder.getWidth();
+        }
+        for (double loops : settings.loops) {
+            std::vector<mazeUtils::PackedRow> rows = perfect;
+            mazeUtils::openWalls(rows, width, loops, settings.seed);
+            mazeUtils::Timings t = mazeUtils::timeEngines(rows, width, settings.repeat);
+
+            const double graph = t.graphParse + t.graphSolve;
+            const double grid = t.gridLoad + t.gridSolve;
+            std::cout << width << "\t" << loops << "\t" << mazeUtils::openFraction(rows, width) << "\t"
+                      << t.nodes << "\t" << t.graphParse << "\t" << t.graphSolve << "\t"
+                      << t.gridLoad << "\t" << t.gridSolve << "\t" << (grid > 0 ? graph / grid : 0) << "x" << std::endl;
+            // Both engines find a shortest route, so they have to agree
+            if (t.graphLength != t.gridLength) {
+                std::cerr << "Solution lengths differ: graph " << t.graphLength << ", bitgrid " << t.gridLength << std::endl;
+                result = 1;
+            }
+        }
+    }
+    return result;
+}
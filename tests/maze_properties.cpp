@@ -0,0 +1,775 @@
+#include "gtest/gtest.h"
+
+#include "maze_bitsolver.h"
+#include "maze_builder.h"
+#include "maze_format.h"
+#include "maze_kernels.h"
+#include "maze_pipeline.h"
+#include "maze_stats.h"
+#include "maze_tiles.h"
+#include "maze_utils.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <queue>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+// Randomised differential tests. Mazes are generated with DepthFirstBuilder
+// in every shape across many seeds and sizes, checked to be perfect mazes,
+// and then run through every parser and solver, each of which is compared
+// against the deliberately simple reference versions in this file.
+//
+//   maze-property-test                  quick run over thousands of small mazes, for CI
+//   maze-property-test --soak           long run over large mazes
+//   --seeds <n> --first-seed <n>        how many seeds to try per shape, and where to start
+//
+// Failures name the shape, seed and size, so they can be rebuilt with
+// mazebuilder --shape <shape> -s <seed> -w <width> -h <height>.
+//
+// Scratch files go in a fresh directory under $TMPDIR (or /tmp), which is
+// removed at the end.
+
+namespace mazeUtils {
+    struct PropertySettings {
+        bool soak = false;
+        unsigned long firstSeed = 1;
+        // 0 picks the default for the mode
+        unsigned long seeds = 0;
+        std::string scratchDir;
+    };
+    PropertySettings settings;
+
+    // grid[y][x], true for open pixels
+    typedef std::vector<std::vector<bool>> Grid;
+
+    Grid readGrid(IRowSource& rows) {
+        Grid grid;
+        PackedRow row;
+        while (grid.size() < rows.height() && rows.nextRow(row)) {
+            std::vector<bool> line(rows.width());
+            for (std::size_t x = 0; x < line.size(); x++) {
+                line[x] = isOpen(row, x);
+            }
+            grid.push_back(line);
+        }
+        return grid;
+    }
+
+    // Keeps the builder's progress report out of the test output
+    class QuietStdout {
+        public:
+            QuietStdout() : saved(std::cout.rdbuf(sink.rdbuf())) {}
+            ~QuietStdout() { std::cout.rdbuf(saved); }
+        private:
+            std::ostringstream sink;
+            std::streambuf* saved;
+    };
+
+    // Reference solver: breadth-first search one pixel at a time, from any
+    // open pixel in the top row to any in the bottom row. Returns the number
+    // of steps, or -1 if the bottom can't be reached.
+    long referenceSolve(const Grid& grid, bool diagonals) {
+        const long height = grid.size();
+        const long width = height == 0 ? 0 : grid[0].size();
+        std::vector<std::vector<long>> distance(height, std::vector<long>(width, -1));
+        std::deque<std::pair<long, long>> queue;
+        for (long x = 0; x < width; x++) {
+            if (grid[0][x]) {
+                distance[0][x] = 0;
+                queue.push_back(std::make_pair(x, 0L));
+            }
+        }
+        while (!queue.empty()) {
+            long x = queue.front().first;
+            long y = queue.front().second;
+            queue.pop_front();
+            if (y == height - 1) return distance[y][x];
+            for (long dy = -1; dy <= 1; dy++) {
+                for (long dx = -1; dx <= 1; dx++) {
+                    if ((dx == 0 && dy == 0) || (!diagonals && dx != 0 && dy != 0)) continue;
+                    long nx = x + dx;
+                    long ny = y + dy;
+                    if (nx < 0 || ny < 0 || nx >= width || ny >= height) continue;
+                    if (!grid[ny][nx] || distance[ny][nx] != -1) continue;
+                    distance[ny][nx] = distance[y][x] + 1;
+                    queue.push_back(std::make_pair(nx, ny));
+                }
+            }
+        }
+        return -1;
+    }
+
+    // Where MazeNetwork should put nodes, written out from the rules rather
+    // than shared with the parser: the first open pixel of the top and bottom
+    // rows, and every open pixel inside that isn't the middle of a straight
+    // corridor.
+    std::size_t referenceNodeCount(const Grid& grid) {
+        const std::size_t height = grid.size();
+        const std::size_t width = grid[0].size();
+        std::size_t count = 0;
+        for (std::size_t y = 0; y < height; y++) {
+            for (std::size_t x = 0; x < width; x++) {
+                if (!grid[y][x]) continue;
+                if (y == 0 || y == height - 1) {
+                    count++;
+                    break;
+                }
+                bool n = grid[y-1][x];
+                bool s = grid[y+1][x];
+                bool e = x + 1 < width && grid[y][x+1];
+                bool w = x > 0 && grid[y][x-1];
+                bool verticalCorridor = n && s && !e && !w;
+                bool horizontalCorridor = e && w && !n && !s;
+                bool isolated = !n && !s && !e && !w;
+                if (!verticalCorridor && !horizontalCorridor && !isolated) count++;
+            }
+        }
+        return count;
+    }
+
+    // Length in pixels of the graph's route through an eight-connected Shape
+    // maze, found cell by cell. MazeNetwork puts a node on each cell's
+    // top-left pixel, so a straight or south-east step from cell to cell
+    // is one pitch, and a south-west one runs between opposite corners and
+    // so crosses cellWidth - 1 more pixels. Returns -1 if there's no route.
+    template <class Shape>
+    long referenceCellSolve(const Grid& grid) {
+        const std::size_t xCells = Shape::cellsFor(grid[0].size());
+        const std::size_t yCells = Shape::cellsFor(grid.size());
+        const long pitch = Shape::pitch;
+        const long wall = Shape::wallWidth;
+        const long diagonal = pitch + Shape::cellWidth - 1;
+        std::vector<long> distance(xCells * yCells, -1);
+        typedef std::pair<long, std::size_t> Entry;
+        std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+        auto reach = [&](std::size_t cx, std::size_t cy, long length) {
+            const std::size_t id = cy * xCells + cx;
+            if (distance[id] != -1 && distance[id] <= length) return;
+            distance[id] = length;
+            queue.push(Entry(length, id));
+        };
+        for (std::size_t cx = 0; cx < xCells; cx++) {
+            if (grid[0][Shape::cellStart(cx)]) reach(cx, 0, wall);
+        }
+        long best = -1;
+        while (!queue.empty()) {
+            const long length = queue.top().first;
+            const std::size_t id = queue.top().second;
+            queue.pop();
+            if (length != distance[id]) continue;
+            const std::size_t cx = id % xCells;
+            const std::size_t cy = id / xCells;
+            const std::size_t left = Shape::cellStart(cx);
+            const std::size_t top = Shape::cellStart(cy);
+            const std::size_t below = top + Shape::cellWidth;
+            const std::size_t right = left + Shape::cellWidth;
+            if (cy + 1 == yCells && grid[grid.size() - 1][left]) {
+                const long exit = length + (long)(grid.size() - 1 - top);
+                if (best == -1 || exit < best) best = exit;
+            }
+            if (cx > 0 && grid[top][left - 1]) reach(cx - 1, cy, length + pitch);
+            if (cx + 1 < xCells && grid[top][right]) reach(cx + 1, cy, length + pitch);
+            if (cy > 0 && grid[top - 1][left]) reach(cx, cy - 1, length + pitch);
+            if (cy + 1 < yCells && grid[below][left]) reach(cx, cy + 1, length + pitch);
+            if (cx > 0 && cy > 0 && grid[top - 1][left - 1]) reach(cx - 1, cy - 1, length + pitch);
+            if (cx + 1 < xCells && cy > 0 && grid[top - 1][right]) reach(cx + 1, cy - 1, length + diagonal);
+            if (cx + 1 < xCells && cy + 1 < yCells && grid[below][right]) reach(cx + 1, cy + 1, length + pitch);
+            if (cx > 0 && cy + 1 < yCells && grid[below][left - 1]) reach(cx - 1, cy + 1, length + diagonal);
+        }
+        return best;
+    }
+
+    // Where MazeNetwork should put nodes in an eight-connected Shape maze:
+    // the entrance and exit, and every cell with a diagonal passage or that
+    // isn't the middle of a straight corridor.
+    template <class Shape>
+    std::size_t referenceCellNodeCount(const Grid& grid) {
+        const std::size_t xCells = Shape::cellsFor(grid[0].size());
+        const std::size_t yCells = Shape::cellsFor(grid.size());
+        std::size_t count = 2;
+        for (std::size_t cy = 0; cy < yCells; cy++) {
+            for (std::size_t cx = 0; cx < xCells; cx++) {
+                const std::size_t left = Shape::cellStart(cx);
+                const std::size_t top = Shape::cellStart(cy);
+                const std::size_t below = top + Shape::cellWidth;
+                const std::size_t right = left + Shape::cellWidth;
+                bool n = grid[top - 1][left];
+                bool s = grid[below][left];
+                bool e = grid[top][right];
+                bool w = grid[top][left - 1];
+                bool diagonal = grid[top - 1][left - 1] || grid[top - 1][right] || grid[below][right] || grid[below][left - 1];
+                bool verticalCorridor = n && s && !e && !w;
+                bool horizontalCorridor = e && w && !n && !s;
+                if (diagonal || (!verticalCorridor && !horizontalCorridor)) count++;
+            }
+        }
+        return count;
+    }
+
+    class UnionFind {
+        public:
+            UnionFind(std::size_t size) : parent(size) {
+                for (std::size_t i = 0; i < size; i++) parent[i] = i;
+            }
+
+            std::size_t find(std::size_t i) {
+                while (parent[i] != i) {
+                    parent[i] = parent[parent[i]];
+                    i = parent[i];
+                }
+                return i;
+            }
+
+            // Returns false if a and b were already joined
+            bool join(std::size_t a, std::size_t b) {
+                a = find(a);
+                b = find(b);
+                if (a == b) return false;
+                parent[a] = b;
+                return true;
+            }
+        private:
+            std::vector<std::size_t> parent;
+    };
+
+    // Pixels of a left x top block that are open
+    std::size_t openPixels(const Grid& grid, std::size_t left, std::size_t top, std::size_t width, std::size_t height) {
+        std::size_t count = 0;
+        for (std::size_t y = top; y < top + height; y++) {
+            for (std::size_t x = left; x < left + width; x++) {
+                count += grid[y][x];
+            }
+        }
+        return count;
+    }
+
+    // Checks that every pixel of grid is where Shape says it should be, and
+    // that the passages join all the cells into a single tree, with one
+    // entrance at the top and one exit at the bottom.
+    template <class Shape>
+    void expectPerfectMaze(const Grid& grid) {
+        const std::size_t height = grid.size();
+        const std::size_t width = grid[0].size();
+        const std::size_t xCells = Shape::cellsFor(width);
+        const std::size_t yCells = Shape::cellsFor(height);
+        const unsigned int cell = Shape::cellWidth;
+        const unsigned int wall = Shape::wallWidth;
+        ASSERT_EQ(Shape::pixelsFor(xCells), width);
+        ASSERT_EQ(Shape::pixelsFor(yCells), height);
+
+        // The border is closed, apart from one cell-wide gap at the top and bottom
+        for (std::size_t band : { std::size_t(0), height - wall }) {
+            std::size_t gaps = 0;
+            for (std::size_t cx = 0; cx < xCells; cx++) {
+                gaps += openPixels(grid, Shape::cellStart(cx), band, cell, wall) == cell * wall;
+            }
+            EXPECT_EQ(gaps, 1) << "in the border at row " << band;
+            EXPECT_EQ(openPixels(grid, 0, band, width, wall), cell * wall) << "in the border at row " << band;
+        }
+        EXPECT_EQ(openPixels(grid, 0, 0, wall, height), 0);
+        EXPECT_EQ(openPixels(grid, width - wall, 0, wall, height), 0);
+
+        UnionFind cells(xCells * yCells);
+        std::size_t passages = 0;
+        auto addPassage = [&](std::size_t a, std::size_t b) {
+            EXPECT_TRUE(cells.join(a, b)) << "passage between cells " << a << " and " << b << " closes a loop";
+            passages++;
+        };
+        for (std::size_t cy = 0; cy < yCells; cy++) {
+            for (std::size_t cx = 0; cx < xCells; cx++) {
+                const std::size_t left = Shape::cellStart(cx);
+                const std::size_t top = Shape::cellStart(cy);
+                const std::size_t id = cy * xCells + cx;
+                ASSERT_EQ(openPixels(grid, left, top, cell, cell), cell * cell) << "cell " << cx << "," << cy;
+
+                // Walls to the east and south are either solid or fully open
+                if (cx + 1 < xCells) {
+                    std::size_t open = openPixels(grid, left + cell, top, wall, cell);
+                    ASSERT_TRUE(open == 0 || open == wall * cell) << "east wall of " << cx << "," << cy;
+                    if (open) addPassage(id, id + 1);
+                }
+                if (cy + 1 < yCells) {
+                    std::size_t open = openPixels(grid, left, top + cell, cell, wall);
+                    ASSERT_TRUE(open == 0 || open == wall * cell) << "south wall of " << cx << "," << cy;
+                    if (open) addPassage(id, id + xCells);
+                }
+
+                // Wall corners are solid, or hold a single diagonal staircase
+                if (cx + 1 < xCells && cy + 1 < yCells) {
+                    std::size_t open = openPixels(grid, left + cell, top + cell, wall, wall);
+                    if (open == 0) continue;
+                    ASSERT_EQ(Shape::connectivity, eightConnected) << "corner below " << cx << "," << cy;
+                    ASSERT_EQ(open, wall) << "corner below " << cx << "," << cy;
+                    bool southEast = true;
+                    bool southWest = true;
+                    for (std::size_t step = 0; step < wall; step++) {
+                        southEast = southEast && grid[top + cell + step][left + cell + step];
+                        southWest = southWest && grid[top + cell + step][left + cell + wall - 1 - step];
+                    }
+                    ASSERT_TRUE(southEast || southWest) << "corner below " << cx << "," << cy;
+                    if (southEast) addPassage(id, id + xCells + 1);
+                    else addPassage(id + 1, id + xCells);
+                }
+            }
+        }
+        // A tree over every cell
+        EXPECT_EQ(passages, xCells * yCells - 1);
+    }
+
+    // Checks that every link in the graph is mirrored by its neighbour and
+    // runs in a straight line along open pixels, or for diagonal links,
+    // down a staircase through the wall corner between two cells.
+    template <class Shape>
+    void expectSymmetricLinks(MazeNetwork& maze, const Grid& grid) {
+        const MazeNetwork::Direction directions[] = {
+            MazeNetwork::north, MazeNetwork::south, MazeNetwork::east, MazeNetwork::west,
+            MazeNetwork::northEast, MazeNetwork::northWest, MazeNetwork::southEast, MazeNetwork::southWest
+        };
+        const long xStep[] = { 0, 0, 1, -1, 1, -1, 1, -1 };
+        const long yStep[] = { -1, 1, 0, 0, -1, -1, 1, 1 };
+        for (MazeNetwork::Node* node : maze.getNodes()) {
+            ASSERT_TRUE(grid[node->getY()][node->getX()]);
+            for (int d = 0; d < 8; d++) {
+                MazeNetwork::Node* neighbor = node->getNeighbor(directions[d]);
+                if (neighbor == NULL) continue;
+                ASSERT_EQ(neighbor->getNeighbor(MazeNetwork::opposite(directions[d])), node)
+                    << "link from " << node->getX() << "," << node->getY() << " isn't mirrored";
+                long x = node->getX();
+                long y = node->getY();
+                if (xStep[d] != 0 && yStep[d] != 0) {
+                    ASSERT_EQ(Shape::connectivity, eightConnected);
+                    ASSERT_EQ((long)neighbor->getX(), x + xStep[d] * (long)Shape::pitch);
+                    ASSERT_EQ((long)neighbor->getY(), y + yStep[d] * (long)Shape::pitch);
+                    // The northward links are checked from the other end
+                    if (yStep[d] < 0) continue;
+                    for (long step = 0; step < (long)Shape::wallWidth; step++) {
+                        const long stairX = xStep[d] > 0 ? x + Shape::cellWidth + step : x - 1 - step;
+                        ASSERT_TRUE(grid[y + Shape::cellWidth + step][stairX])
+                            << "diagonal link from " << node->getX() << "," << node->getY() << " crosses a wall";
+                    }
+                    continue;
+                }
+                do {
+                    x += xStep[d];
+                    y += yStep[d];
+                    ASSERT_TRUE(x >= 0 && y >= 0 && y < (long)grid.size() && x < (long)grid[0].size()
+                                && grid[y][x]) << "link from " << node->getX() << "," << node->getY() << " crosses a wall";
+                } while (x != (long)neighbor->getX() || y != (long)neighbor->getY());
+            }
+        }
+    }
+
+    // Checks that path runs from the top row to the bottom row in single
+    // moves between open pixels
+    void expectValidPath(const TrackedVector<BitGridSolver::Point>& path, const Grid& grid, bool diagonals) {
+        ASSERT_FALSE(path.empty());
+        EXPECT_EQ(path.front().y, 0);
+        EXPECT_EQ(path.back().y, grid.size() - 1);
+        for (std::size_t i = 0; i < path.size(); i++) {
+            ASSERT_TRUE(grid[path[i].y][path[i].x]) << "path step " << i << " is in a wall";
+            if (i == 0) continue;
+            std::size_t dx = path[i].x > path[i-1].x ? path[i].x - path[i-1].x : path[i-1].x - path[i].x;
+            std::size_t dy = path[i].y > path[i-1].y ? path[i].y - path[i-1].y : path[i-1].y - path[i].y;
+            ASSERT_TRUE(diagonals ? (dx <= 1 && dy <= 1 && dx + dy > 0) : dx + dy == 1) << "path step " << i << " jumps";
+        }
+    }
+
+    void writeLittleEndian(std::vector<uint8_t>& out, uint32_t value, int bytes) {
+        for (int i = 0; i < bytes; i++) out.push_back((value >> (8 * i)) & 0xff);
+    }
+
+    void writeBigEndian(std::vector<uint8_t>& out, uint32_t value) {
+        for (int i = 3; i >= 0; i--) out.push_back((value >> (8 * i)) & 0xff);
+    }
+
+    // A plain bottom-up 24-bit BMP
+    std::vector<uint8_t> encodeBmp(const Grid& grid) {
+        const uint32_t height = grid.size();
+        const uint32_t width = grid[0].size();
+        const uint32_t rowBytes = (width * 3 + 3) & ~3u;
+        std::vector<uint8_t> bmp = { 'B', 'M' };
+        writeLittleEndian(bmp, 54 + rowBytes * height, 4);
+        writeLittleEndian(bmp, 0, 4);
+        writeLittleEndian(bmp, 54, 4);
+        writeLittleEndian(bmp, 40, 4);
+        writeLittleEndian(bmp, width, 4);
+        writeLittleEndian(bmp, height, 4);
+        writeLittleEndian(bmp, 1, 2);
+        writeLittleEndian(bmp, 24, 2);
+        writeLittleEndian(bmp, 0, 4);
+        writeLittleEndian(bmp, rowBytes * height, 4);
+        writeLittleEndian(bmp, 2835, 4);
+        writeLittleEndian(bmp, 2835, 4);
+        writeLittleEndian(bmp, 0, 4);
+        writeLittleEndian(bmp, 0, 4);
+        for (uint32_t y = height; y-- > 0;) {
+            for (uint32_t x = 0; x < width; x++) {
+                bmp.insert(bmp.end(), 3, grid[y][x] ? 255 : 0);
+            }
+            bmp.insert(bmp.end(), rowBytes - width * 3, 0);
+        }
+        return bmp;
+    }
+
+    uint32_t crc32(const uint8_t* data, std::size_t size) {
+        uint32_t crc = 0xffffffff;
+        for (std::size_t i = 0; i < size; i++) {
+            crc ^= data[i];
+            for (int bit = 0; bit < 8; bit++) {
+                crc = (crc >> 1) ^ (0xedb88320 & (0 - (crc & 1)));
+            }
+        }
+        return ~crc;
+    }
+
+    void appendChunk(std::vector<uint8_t>& png, const char* type, const std::vector<uint8_t>& data) {
+        writeBigEndian(png, data.size());
+        std::vector<uint8_t> body(type, type + 4);
+        body.insert(body.end(), data.begin(), data.end());
+        png.insert(png.end(), body.begin(), body.end());
+        writeBigEndian(png, crc32(body.data(), body.size()));
+    }
+
+    // A 1-bit greyscale PNG, cycling through all five row filters and using
+    // stored deflate blocks split over two IDAT chunks
+    std::vector<uint8_t> encodePng(const Grid& grid) {
+        const uint32_t height = grid.size();
+        const uint32_t width = grid[0].size();
+        const std::size_t rowBytes = (width + 7) / 8;
+
+        std::vector<uint8_t> scanlines;
+        std::vector<uint8_t> prior(rowBytes, 0);
+        for (uint32_t y = 0; y < height; y++) {
+            std::vector<uint8_t> raw(rowBytes, 0);
+            for (uint32_t x = 0; x < width; x++) {
+                if (grid[y][x]) raw[x / 8] |= 0x80 >> (x % 8);
+            }
+            const uint8_t filter = y % 5;
+            scanlines.push_back(filter);
+            for (std::size_t i = 0; i < rowBytes; i++) {
+                int a = i > 0 ? raw[i-1] : 0;
+                int b = prior[i];
+                int c = i > 0 ? prior[i-1] : 0;
+                int predicted = 0;
+                if (filter == 1) predicted = a;
+                else if (filter == 2) predicted = b;
+                else if (filter == 3) predicted = (a + b) / 2;
+                else if (filter == 4) {
+                    int p = a + b - c;
+                    int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+                    predicted = (pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c);
+                }
+                scanlines.push_back((raw[i] - predicted) & 0xff);
+            }
+            prior = raw;
+        }
+
+        std::vector<uint8_t> zlib = { 0x78, 0x01 };
+        uint32_t adlerA = 1, adlerB = 0;
+        for (uint8_t byte : scanlines) {
+            adlerA = (adlerA + byte) % 65521;
+            adlerB = (adlerB + adlerA) % 65521;
+        }
+        std::size_t done = 0;
+        do {
+            std::size_t length = std::min<std::size_t>(scanlines.size() - done, 65535);
+            zlib.push_back(done + length == scanlines.size() ? 1 : 0);
+            writeLittleEndian(zlib, length, 2);
+            writeLittleEndian(zlib, ~length & 0xffff, 2);
+            zlib.insert(zlib.end(), scanlines.begin() + done, scanlines.begin() + done + length);
+            done += length;
+        } while (done < scanlines.size());
+        writeBigEndian(zlib, (adlerB << 16) | adlerA);
+
+        std::vector<uint8_t> png = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+        std::vector<uint8_t> header;
+        writeBigEndian(header, width);
+        writeBigEndian(header, height);
+        header.insert(header.end(), { 1, 0, 0, 0, 0 });
+        appendChunk(png, "IHDR", header);
+        const std::size_t half = zlib.size() / 2;
+        appendChunk(png, "IDAT", std::vector<uint8_t>(zlib.begin(), zlib.begin() + half));
+        appendChunk(png, "IDAT", std::vector<uint8_t>(zlib.begin() + half, zlib.end()));
+        appendChunk(png, "IEND", std::vector<uint8_t>());
+        return png;
+    }
+
+    Grid decodeBytes(const std::vector<uint8_t>& bytes) {
+        std::unique_ptr<IRowSource> rows = decodeRowSource(
+            std::unique_ptr<IByteSource>(new MemoryByteSource(bytes)));
+        return rows ? readGrid(*rows) : Grid();
+    }
+
+    Grid decodeFile(std::string filePath) {
+        std::unique_ptr<IRowSource> rows = openRowSource(filePath);
+        return rows ? readGrid(*rows) : Grid();
+    }
+
+    // Every file format must decode back to exactly the generated pixels
+    void expectParsersAgree(const std::vector<PackedRow>& rows, const Grid& pixels) {
+        const std::string nativePath = settings.scratchDir + "/property_test.maze";
+        for (bool rle : { false, true }) {
+            NativeMazeWriter writer(nativePath, pixels[0].size(), pixels.size(), rle);
+            for (auto& row : rows) writer.writeRow(row);
+            ASSERT_TRUE(writer.close());
+            EXPECT_EQ(decodeFile(nativePath), pixels) << (rle ? "native RLE" : "native packed");
+        }
+        std::remove(nativePath.c_str());
+
+        std::vector<uint8_t> bmp = encodeBmp(pixels);
+        EXPECT_EQ(decodeBytes(bmp), pixels) << "BMP streamed";
+        const std::string bmpPath = settings.scratchDir + "/property_test.bmp";
+        {
+            std::ofstream file(bmpPath, std::ios::binary);
+            file.write(reinterpret_cast<const char*>(bmp.data()), bmp.size());
+        }
+        EXPECT_EQ(decodeFile(bmpPath), pixels) << "BMP file";
+        BitmapRowSource bitmap(bmpPath);
+        ASSERT_TRUE(bitmap.isOpen());
+        EXPECT_EQ(readGrid(bitmap), pixels) << "BMP through bitmap_image";
+        std::remove(bmpPath.c_str());
+
+        EXPECT_EQ(decodeBytes(encodePng(pixels)), pixels) << "PNG";
+    }
+
+    // Builds one maze and runs it through everything
+    template <class Shape>
+    void checkMaze(unsigned long seed, unsigned int width, unsigned int height) {
+        std::vector<PackedRow> rows;
+        unsigned int builtWidth;
+        {
+            QuietStdout quiet;
+            mazeBuilder::DepthFirstBuilder builder(seed, width, height, Shape::name());
+            rows = builder.makeRows();
+            builtWidth = builder.getWidth();
+        }
+        MemoryRowSource pixelRows(builtWidth, rows);
+        const Grid pixels = readGrid(pixelRows);
+        ASSERT_FALSE(pixels.empty());
+
+        expectPerfectMaze<Shape>(pixels);
+        if (::testing::Test::HasFatalFailure()) return;
+        expectParsersAgree(rows, pixels);
+
+        // Four-connected shapes are solved a cell or wall at a time on the
+        // lattice they sample down to, then measured in pixels: the border
+        // to the first cell, a pitch per cell after it, then to the bottom.
+        // Eight-connected ones are flooded pixel by pixel, but the graph
+        // still steps from cell to cell.
+        const bool diagonals = Shape::connectivity == eightConnected;
+        long expected, expectedGraph;
+        std::size_t expectedNodes;
+        if (diagonals) {
+            expected = referenceSolve(pixels, true);
+            expectedGraph = referenceCellSolve<Shape>(pixels);
+            expectedNodes = referenceCellNodeCount<Shape>(pixels);
+        } else {
+            MemoryRowSource source(builtWidth, rows);
+            LatticeRowSource<Shape> lattice(source);
+            const Grid grid = readGrid(lattice);
+            const long steps = referenceSolve(grid, false);
+            ASSERT_GE(steps, 2) << "perfect maze with no route through it";
+            expected = Shape::wallWidth + (steps - 2) / 2 * Shape::pitch + Shape::pitch - 1;
+            expectedGraph = expected;
+            expectedNodes = referenceNodeCount(grid);
+        }
+        ASSERT_GE(expected, 0) << "perfect maze with no route through it";
+        ASSERT_GE(expectedGraph, expected);
+
+        const SolverKernels* kernels = findSolverKernels(Shape::name());
+        ASSERT_TRUE(kernels != NULL);
+        BitGridSolver bitGrid;
+        MemoryRowSource bitGridRows(builtWidth, rows);
+        ASSERT_EQ(kernels->loadGrid(bitGrid, bitGridRows), 0);
+        ASSERT_TRUE(kernels->solveGrid(bitGrid));
+        EXPECT_EQ((long)bitGrid.getPath().size() - 1, expected) << "bitgrid";
+        expectValidPath(bitGrid.getPath(), pixels, diagonals);
+
+        MazeNetwork graph;
+        MemoryRowSource graphRows(builtWidth, rows);
+        ASSERT_EQ(kernels->parseGraph(graph, graphRows), 0);
+        EXPECT_EQ(graph.getNodeCount(), expectedNodes);
+        expectSymmetricLinks<Shape>(graph, pixels);
+        auto route = graph.solve();
+        ASSERT_FALSE(route.empty());
+        EXPECT_EQ((long)graph.getSolutionLength(), expectedGraph) << "graph";
+        EXPECT_EQ(route.front()->getY(), 0);
+        EXPECT_EQ(route.back()->getY(), pixels.size() - 1);
+
+        // A perfect maze's graph is a tree, and the streaming statistics
+        // see the same one without building it
+        MazeStats stats = analyzeNetwork(graph, route, 2);
+        EXPECT_EQ(stats.corridors + 1, stats.nodes);
+        EXPECT_EQ((long)stats.solutionLength, expectedGraph);
+        MazeStats streamed;
+        MemoryRowSource statsRows(builtWidth, rows);
+        ASSERT_EQ(analyzeRows<Shape>(statsRows, streamed), 0);
+        streamed.addSolution(std::vector<MazeStats::RouteNode>());
+        stats.solved = false;
+        EXPECT_EQ(streamed.toJson(), stats.toJson()) << "streamed statistics";
+
+        // The tiled engine only reads the classic shape. Small tiles and a
+        // tiny cache make sure tiles are evicted and read back.
+        if (Shape::name() != ClassicShape::name()) return;
+        TiledNetwork tiled(settings.scratchDir, settings.soak ? 64 : 8, 2);
+        MemoryRowSource tiledRows(builtWidth, rows);
+        ASSERT_EQ(tiled.parse(tiledRows), 0);
+        EXPECT_EQ(tiled.getNodeCount(), graph.getNodeCount());
+        auto tiledRoute = tiled.solve();
+        EXPECT_FALSE(tiledRoute.empty());
+        EXPECT_EQ((long)tiled.getSolutionLength(), expected) << "tiled";
+        std::vector<MazeStats::RouteNode> steps;
+        for (auto& point : tiledRoute) steps.push_back({point.x, point.y, tiled.getLinkCount(point.x, point.y)});
+        streamed.addSolution(steps);
+        stats.solved = true;
+        EXPECT_EQ(streamed.toJson(), stats.toJson()) << "tiled route statistics";
+    }
+
+    TEST(MazePropertyTest, generatedMazesAgreeWithReference) {
+        // Quick mode tries thousands of small mazes, soak mode fewer large ones
+        const unsigned long seeds = settings.seeds != 0 ? settings.seeds : (settings.soak ? 40 : 500);
+        const unsigned int minSize = settings.soak ? 200 : 3;
+        const unsigned int maxSize = settings.soak ? 2000 : 48;
+        std::size_t mazes = 0;
+
+        forEachShape([&](auto shape) {
+            typedef decltype(shape) Shape;
+            // Sizes come from the seed, so a failure can be replayed alone
+            for (unsigned long seed = settings.firstSeed; seed < settings.firstSeed + seeds; seed++) {
+                std::mt19937 sizes(seed);
+                std::uniform_int_distribution<unsigned int> size(std::max<unsigned int>(minSize, Shape::pixelsFor(1)), maxSize);
+                const unsigned int width = size(sizes);
+                const unsigned int height = size(sizes);
+
+                std::ostringstream trace;
+                trace << "--shape " << Shape::name() << " -s " << seed << " -w " << width << " -h " << height;
+                SCOPED_TRACE(trace.str());
+                checkMaze<Shape>(seed, width, height);
+                mazes++;
+                // One broken maze is enough to go on
+                if (::testing::Test::HasFailure()) return;
+            }
+        });
+        std::cout << "Checked " << mazes << " mazes" << std::endl;
+    }
+
+    void writeFile(std::string filePath, const std::vector<uint8_t>& bytes) {
+        std::ofstream file(filePath, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+    }
+
+    TEST(MazePropertyTest, pipelineAgreesWithReference) {
+        // A batch of classic mazes in every format the pipeline decodes
+        const unsigned long count = settings.seeds != 0 ? settings.seeds : (settings.soak ? 12 : 30);
+        const unsigned int minSize = settings.soak ? 200 : 3;
+        const unsigned int maxSize = settings.soak ? 1000 : 48;
+        std::vector<std::string> filePaths;
+        std::vector<long> expected;
+        std::vector<std::size_t> expectedNodes;
+        for (unsigned long seed = settings.firstSeed; seed < settings.firstSeed + count; seed++) {
+            std::mt19937 sizes(seed);
+            std::uniform_int_distribution<unsigned int> size(minSize, maxSize);
+            const unsigned int width = size(sizes);
+            const unsigned int height = size(sizes);
+            std::vector<PackedRow> rows;
+            unsigned int builtWidth;
+            {
+                QuietStdout quiet;
+                mazeBuilder::DepthFirstBuilder builder(seed, width, height);
+                rows = builder.makeRows();
+                builtWidth = builder.getWidth();
+            }
+            MemoryRowSource source(builtWidth, rows);
+            const Grid pixels = readGrid(source);
+
+            std::ostringstream filePath;
+            filePath << settings.scratchDir << "/pipeline_" << seed;
+            switch (seed % 4) {
+                case 0:
+                case 1: {
+                    filePath << ".maze";
+                    NativeMazeWriter writer(filePath.str(), builtWidth, rows.size(), seed % 4 == 1);
+                    for (auto& row : rows) writer.writeRow(row);
+                    ASSERT_TRUE(writer.close());
+                    break;
+                }
+                case 2:
+                    filePath << ".png";
+                    writeFile(filePath.str(), encodePng(pixels));
+                    break;
+                default:
+                    filePath << ".bmp";
+                    writeFile(filePath.str(), encodeBmp(pixels));
+                    break;
+            }
+            filePaths.push_back(filePath.str());
+            expected.push_back(referenceSolve(pixels, false));
+            expectedNodes.push_back(referenceNodeCount(pixels));
+        }
+
+        // Blocks small enough to split the headers, a size that leaves rows
+        // straddling blocks, and blocks big enough to hold a whole file
+        for (std::string engine : { "graph", "bitgrid" }) {
+            for (bool useIoUring : { true, false }) {
+                for (std::size_t blockSize : { 5, 61, 1 << 20 }) {
+                    MazePipeline::Options options;
+                    options.engine = engine;
+                    options.useIoUring = useIoUring;
+                    options.blockSize = blockSize;
+                    options.parseWorkers = 3;
+                    MazePipeline pipeline(options);
+                    auto results = pipeline.run(filePaths);
+
+                    std::ostringstream trace;
+                    trace << engine << " engine, " << pipeline.getReaderName() << " reader, " << blockSize << " byte blocks";
+                    SCOPED_TRACE(trace.str());
+                    ASSERT_EQ(results.size(), filePaths.size());
+                    for (std::size_t i = 0; i < results.size(); ++i) {
+                        ASSERT_TRUE(results[i].solved) << results[i].filePath << ": " << results[i].error;
+                        EXPECT_EQ((long)results[i].solutionLength, expected[i]) << results[i].filePath;
+                        if (engine == "graph") {
+                            EXPECT_EQ(results[i].nodes, expectedNodes[i]) << results[i].filePath;
+                        }
+                    }
+                }
+            }
+        }
+        for (auto& filePath : filePaths) std::remove(filePath.c_str());
+    }
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    for (int i = 1; i < argc; i++) {
+        std::string arg(argv[i]);
+        if (arg == "--soak") {
+            mazeUtils::settings.soak = true;
+        }
+        else if (arg == "--seeds" && i + 1 < argc) {
+            mazeUtils::settings.seeds = std::stoul(std::string(argv[++i]));
+        }
+        else if (arg == "--first-seed" && i + 1 < argc) {
+            mazeUtils::settings.firstSeed = std::stoul(std::string(argv[++i]));
+        }
+    }
+
+    const char* tmp = std::getenv("TMPDIR");
+    std::string scratchTemplate = std::string(tmp != NULL && *tmp ? tmp : "/tmp") + "/maze-property-XXXXXX";
+    if (mkdtemp(&scratchTemplate[0]) == NULL) {
+        std::cerr << "Couldn't make a scratch directory in " << scratchTemplate << std::endl;
+        return 1;
+    }
+    mazeUtils::settings.scratchDir = scratchTemplate;
+    int result = RUN_ALL_TESTS();
+    rmdir(mazeUtils::settings.scratchDir.c_str());
+    return result;
+}